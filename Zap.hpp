@@ -2,11 +2,18 @@
 
 #include <Arduino.h>
 #include <avr/pgmspace.h>
+#include <limits.h>
 #include <stdint.h>
 
 #include "zap_helpers.hpp"
-#include "zap_arg_parser.hpp"
 #include "zap_string_table.hpp"
+#include "zap_number.hpp"
+#include "zap_arg_parser.hpp"
+#include "zap_cobs.hpp"
+#include "zap_hex.hpp"
+#include "zap_bitset.hpp"
+#include "zap_scheduler.hpp"
+#include "zap_stats.hpp"
 
 #define ZAP_PARSE_ARGS(str, len) ZAP_PARSE_ARGS_EX(args, arg, str, len)
 
@@ -19,9 +26,9 @@ namespace zap {
 extern const uint8_t FRAME_TYPE_BINARY;
 extern const uint8_t FRAME_TYPE_TEXT;
 
-class Stream;
-
 };  // namespace zap
 
 #include "zap_protocol.hpp"
-#include "zap_stream.hpp"
\ No newline at end of file
+#include "zap_config.hpp"
+#include "zap_stream.hpp"
+#include "zap_router.hpp"
\ No newline at end of file
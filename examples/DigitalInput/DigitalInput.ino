@@ -8,7 +8,7 @@ class AnalogSensor : public zap::ScalarSensorStream<uint16_t> {
   AnalogSensor(uint8_t pin) : pin_(pin) {}
   void tick() { setValue(analogRead(pin_)); }
   void describe() { proto->writeRaw(F("name:analogSensor class:sensor value:[x] min:0 max:1023")); }
-  void report() { proto->port()->print(value(), DEC); }
+  void report() { proto->writeInteger(value()); }
 private:
   uint8_t pin_;
 };
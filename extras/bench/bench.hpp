@@ -0,0 +1,63 @@
+#pragma once
+
+// Shared helpers for the host benchmarks.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+
+namespace bench {
+
+class Timer {
+ public:
+  Timer() : start_(std::chrono::steady_clock::now()) {}
+
+  double elapsedNanos() const {
+    auto d = std::chrono::steady_clock::now() - start_;
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+  }
+
+ private:
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Prevent the optimiser from discarding a computed value.
+template <typename T>
+inline void keep(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Repeat s n times.
+inline std::string repeat(const std::string &s, size_t n) {
+  std::string out;
+  out.reserve(s.size() * n);
+  for (size_t i = 0; i < n; i++) out += s;
+  return out;
+}
+
+// Parse "-n <count>" from the command line, falling back to def.
+inline size_t iterations(int argc, char **argv, size_t def) {
+  for (int i = 1; i + 1 < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0) return (size_t)strtoull(argv[i + 1], nullptr, 10);
+  }
+  return def;
+}
+
+inline void printHeader(const char *title) {
+  printf("\n%s\n", title);
+  printf("%-24s %10s %14s %10s %12s %12s\n", "case", "frames", "frames/sec", "ns/frame",
+         "bytes/resp", "writes/resp");
+}
+
+inline void printRow(const char *name, uint64_t frames, double nanos, uint64_t bytes,
+                     uint64_t writes) {
+  double f = frames ? (double)frames : 1.0;
+  printf("%-24s %10llu %14.0f %10.1f %12.1f %12.1f\n", name, (unsigned long long)frames,
+         frames * 1e9 / nanos, nanos / f, bytes / f, writes / f);
+}
+
+};  // namespace bench
@@ -0,0 +1,125 @@
+// Host client benchmark.
+//
+// Runs a device on a thread of its own, connected to a zap::Client by a
+// socketpair, and compares waiting for each reply before sending the next
+// request with keeping a window of tagged requests in flight. Prints
+// requests/sec for reads and for enumerating every stream with desc.
+//
+// Usage: zap_bench_client [-n requests]
+
+#include "Zap.hpp"
+#include "bench.hpp"
+#include "fd_stream.hpp"
+#include "zap_client.hpp"
+
+#include <sys/socket.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const char deviceInfo[] PROGMEM =
+    "vendor:\"Test\" product:\"Bench Device\" id:\"com.example.bench\"";
+
+const int STREAM_COUNT = 8;
+
+class BenchSensor : public zap::ScalarSensorStream<uint16_t> {
+ public:
+  void describe() {
+    proto->writeRaw(F("name:benchSensor class:sensor value:[x] min:0 max:1023"));
+  }
+};
+
+// A device serving requests until stopped
+class Device {
+ public:
+  Device(int fd) : port_(fd), protocol_(&port_, F(deviceInfo)) {
+    for (int i = 0; i < STREAM_COUNT; i++) {
+      protocol_.setStreamHandler(i + 1, &sensors_[i]);
+      sensors_[i].enable();
+      sensors_[i].setValue(100 + i);
+    }
+    protocol_.begin();
+    thread_ = std::thread([this] {
+      while (!stop_) {
+        if (port_.waitForInput(5)) protocol_.tick();
+      }
+    });
+  }
+
+  ~Device() {
+    stop_ = true;
+    thread_.join();
+  }
+
+ private:
+  host::FdStream port_;
+  zap::Protocol<STREAM_COUNT, 96, 64> protocol_;
+  BenchSensor sensors_[STREAM_COUNT];
+  std::atomic<bool> stop_{false};
+  std::thread thread_;
+};
+
+// Make n requests, cycling through the streams, and return ns per request
+template <typename MakeRequest>
+double run(zap::Client &client, size_t n, int window, MakeRequest make) {
+  std::vector<std::future<zap::Reply>> replies;
+  replies.reserve(n);
+  bench::Timer t;
+  for (size_t i = 0; i < n; i++) {
+    replies.push_back(make(client, (int)(i % STREAM_COUNT) + 1));
+    if (window == 1) replies.back().wait();
+  }
+  size_t failed = 0;
+  for (auto &r : replies) {
+    if (!r.get().received()) failed++;
+  }
+  double nanos = t.elapsedNanos();
+  if (failed) printf("  %zu requests failed\n", failed);
+  return nanos / n;
+}
+
+void printRow(const char *name, size_t n, double nanosPerReq) {
+  printf("%-28s %10zu %14.0f %10.1f\n", name, n, 1e9 / nanosPerReq, nanosPerReq / 1000);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  size_t n = bench::iterations(argc, argv, 20000);
+
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+    perror("socketpair");
+    return 1;
+  }
+  Device device(sv[1]);
+
+  zap::Client client(sv[0]);
+  client.setWindow(1);
+  zap::Reply hello = client.start();
+  printf("hello: %s\ntags: %s\n", hello.frame.body.c_str(), client.tagged() ? "yes" : "no");
+  zap::Reply desc = client.call(0, "desc " + client.streamID(1));
+  printf("desc: %s\n", desc.frame.body.c_str());
+
+  auto read = [](zap::Client &c, int stream) { return c.request(stream, "read"); };
+  auto describe = [](zap::Client &c, int stream) {
+    return c.request(0, "desc " + c.streamID(stream));
+  };
+
+  printf("\n%-28s %10s %14s %10s\n", "case", "requests", "requests/sec", "us/req");
+  const int windows[] = {1, 4, 8};
+  for (int window : windows) {
+    char name[32];
+    client.setWindow(window);
+    snprintf(name, sizeof(name), "read, window %d", window);
+    printRow(name, n, run(client, n, window, read));
+    snprintf(name, sizeof(name), "desc, window %d", window);
+    printRow(name, n, run(client, n, window, describe));
+  }
+
+  client.close();
+  return 0;
+}
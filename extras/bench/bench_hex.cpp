@@ -0,0 +1,114 @@
+// Hex codec benchmark.
+//
+// Compares the table/SWAR codec in zap_hex.cpp against the per-nibble
+// implementation it replaced, on large binary payloads.
+//
+// Usage: zap_bench_hex [-n iterations]
+
+#include "Zap.hpp"
+#include "bench.hpp"
+#include "memory_stream.hpp"
+
+#include <vector>
+
+namespace {
+
+// The previous implementation: toHex() twice per byte and a port write
+// per character (here into a flat buffer, which flatters it).
+void legacyEncode(const uint8_t *src, size_t len, char *dst) {
+  while (len--) {
+    *dst++ = zap::toHex(*src >> 4);
+    *dst++ = zap::toHex((*src++) & 0xF);
+  }
+}
+
+uint8_t legacyDecodeHexit(char ch) {
+  if (ch >= '0' && ch <= '9') {
+    return ch - '0';
+  } else if (ch >= 'A' && ch <= 'F') {
+    return ch - 'A' + 10;
+  } else if (ch >= 'a' && ch <= 'f') {
+    return ch - 'a' + 10;
+  } else {
+    return zap::INVALID_HEXIT;
+  }
+}
+
+int legacyDecode(const char *src, size_t len, uint8_t *dst) {
+  if (len % 2 != 0) return -1;
+  int wp = 0;
+  for (size_t rp = 0; rp < len; rp += 2) {
+    uint8_t high = legacyDecodeHexit(src[rp]);
+    uint8_t low = legacyDecodeHexit(src[rp + 1]);
+    if ((high | low) & 0x80) return -1;
+    dst[wp++] = (high << 4) | low;
+  }
+  return wp;
+}
+
+void printHeader(const char *title) {
+  printf("\n%s\n", title);
+  printf("%-24s %10s %12s %12s\n", "case", "bytes", "MB/s", "ns/byte");
+}
+
+void printRow(const char *name, size_t bytes, size_t iterations, double nanos) {
+  double total = (double)bytes * iterations;
+  printf("%-24s %10zu %12.1f %12.3f\n", name, bytes, total * 1e3 / nanos, nanos / total);
+}
+
+template <typename F>
+void run(const char *name, size_t bytes, size_t iterations, F fn) {
+  bench::Timer t;
+  for (size_t i = 0; i < iterations; i++) fn();
+  printRow(name, bytes, iterations, t.elapsedNanos());
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  size_t iterations = bench::iterations(argc, argv, 20000);
+  const size_t sizes[] = {64, 4096};
+
+  for (size_t size : sizes) {
+    std::vector<uint8_t> payload(size);
+    for (size_t i = 0; i < size; i++) payload[i] = (uint8_t)(i * 37 + 11);
+    std::vector<char> hex(size * 2);
+    std::vector<uint8_t> decoded(size);
+
+    char title[64];
+    snprintf(title, sizeof(title), "Hex codec, %zu byte payload", size);
+    printHeader(title);
+
+    run("encode (legacy)", size, iterations, [&] {
+      legacyEncode(payload.data(), size, hex.data());
+      bench::keep(hex[0]);
+    });
+    run("encode (zap_hex)", size, iterations, [&] {
+      zap::hexEncode(payload.data(), size, hex.data());
+      bench::keep(hex[0]);
+    });
+    run("decode (legacy)", size, iterations, [&] {
+      bench::keep(legacyDecode(hex.data(), hex.size(), decoded.data()));
+    });
+    run("decode (zap_hex)", size, iterations, [&] {
+      bench::keep(zap::hexDecode(hex.data(), hex.size(), decoded.data()));
+    });
+
+    // End to end through BaseProtocol::writeBinaryBody()
+    host::MemoryStream port;
+    zap::BaseProtocol unbuffered(&port);
+    uint8_t txBuffer[256];
+    zap::BaseProtocol buffered(&port, txBuffer, sizeof(txBuffer));
+
+    run("writeBinary (unbuffered)", size, iterations, [&] {
+      unbuffered.writeBinaryBody((char *)payload.data(), size);
+      unbuffered.endFrame();
+    });
+    run("writeBinary (buffered)", size, iterations, [&] {
+      buffered.writeBinaryBody((char *)payload.data(), size);
+      buffered.endFrame();
+    });
+  }
+
+  return 0;
+}
@@ -0,0 +1,149 @@
+// Simulated link benchmark.
+//
+// Runs the DigitalInput example sketch behind a simulated serial link and
+// drives it with zap::Client at a range of baud rates, to show where the
+// wire rather than the device sets the limits. For each rate prints:
+//
+//   - round-trip time of a read, one request at a time
+//   - reads/sec with a window of 8 requests in flight
+//   - reports/sec with both sensors reporting every 1ms, i.e. as fast as
+//     the link allows, and the share of the link's bandwidth they use
+//   - round-trip time of a read while the link is saturated with reports
+//
+// Usage: zap_bench_link [-l latency-us]
+
+#include "DigitalInput.ino"
+#include "bench.hpp"
+#include "device_runner.hpp"
+#include "serial_link.hpp"
+#include "zap_client.hpp"
+
+#include <signal.h>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace {
+
+std::atomic<uint64_t> reportCount{0};
+
+void driveInputs(unsigned long ms) {
+  host::setAnalogPin(1, (int)(ms % 1024));
+  host::setAnalogPin(2, (int)(1023 - ms % 1024));
+}
+
+struct RTT {
+  double meanUs = 0;
+  double maxUs = 0;
+  size_t failed = 0;
+};
+
+// Make n reads one at a time and time each round trip
+RTT sequential(zap::Client &client, size_t n) {
+  RTT rtt;
+  double total = 0;
+  for (size_t i = 0; i < n; i++) {
+    bench::Timer t;
+    zap::Reply r = client.call(4, "read");
+    double us = t.elapsedNanos() / 1000;
+    if (!r.received()) rtt.failed++;
+    total += us;
+    rtt.maxUs = std::max(rtt.maxUs, us);
+  }
+  rtt.meanUs = total / n;
+  return rtt;
+}
+
+// Make n reads with the client's window full and return reads/sec.
+// Requests lost to overruns are counted in failed.
+double pipelined(zap::Client &client, size_t n, size_t *failed) {
+  std::vector<std::future<zap::Reply>> replies;
+  replies.reserve(n);
+  bench::Timer t;
+  for (size_t i = 0; i < n; i++) replies.push_back(client.request(4 + i % 2, "read"));
+  for (auto &r : replies) {
+    if (!r.get().received()) (*failed)++;
+  }
+  return n * 1e9 / t.elapsedNanos();
+}
+
+void runBaud(uint32_t baud, uint32_t latencyUs) {
+  sim::LinkConfig config;
+  config.baud = baud;
+  config.latencyUs = latencyUs;
+  sim::SerialLink link(config);
+  int fd = link.openSocket();
+  if (fd < 0) {
+    perror("socketpair");
+    return;
+  }
+  sim::DeviceRunner runner(&link, setup, loop, driveInputs);
+  runner.start();
+
+  zap::Client client(fd);
+  client.setTimeout(1000);
+  client.setWindow(1);
+  client.setNotificationHandler([](const zap::Frame &f) {
+    if (f.body.compare(0, 6, "report") == 0) reportCount++;
+  });
+  if (!client.start().received()) {
+    printf("%-9u no reply to hello\n", baud);
+    runner.stop();
+    return;
+  }
+
+  // The sketch's sensors start disabled
+  client.call(4, "enable true");
+  client.call(5, "enable true");
+
+  // Keep each phase to a fraction of a second at 9600 baud
+  size_t n = std::max<size_t>(10, baud / 5000);
+
+  RTT idle = sequential(client, n);
+
+  client.setWindow(8);
+  size_t lost = 0;
+  double readsPerSec = pipelined(client, n * 4, &lost);
+  client.setWindow(1);
+
+  // Saturate the link with reports
+  client.call(0, "report on 1 4 5");
+  uint64_t reports0 = reportCount;
+  uint64_t bytes0 = link.stats().toHost;
+  bench::Timer t;
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  double secs = t.elapsedNanos() / 1e9;
+  double reportsPerSec = (reportCount - reports0) / secs;
+  double usage = (link.stats().toHost - bytes0) / secs / (baud / 10.0);
+
+  RTT loaded = sequential(client, std::max<size_t>(5, n / 4));
+  client.call(0, "report off");
+
+  runner.stop();
+  client.close();
+  sim::LinkStats stats = link.stats();
+  link.close();
+
+  lost += idle.failed + loaded.failed;
+  printf("%-9u %9.0f %9.0f %10.0f %11.0f %7.0f%% %9.0f %9.0f %9llu %6zu\n", baud, idle.meanUs,
+         idle.maxUs, readsPerSec, reportsPerSec, usage * 100, loaded.meanUs, loaded.maxUs,
+         (unsigned long long)stats.overruns, lost);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  uint32_t latencyUs = 1000;
+  for (int i = 1; i + 1 < argc; i++) {
+    if (strcmp(argv[i], "-l") == 0) latencyUs = strtoul(argv[i + 1], nullptr, 10);
+  }
+  signal(SIGPIPE, SIG_IGN);
+
+  printf("latency %u us each way\n\n", latencyUs);
+  printf("%-9s %9s %9s %10s %11s %8s %9s %9s %9s %6s\n", "baud", "rtt us", "max us",
+         "reads/s", "reports/s", "link", "busy rtt", "busy max", "overruns", "lost");
+  const uint32_t bauds[] = {9600, 115200, 1000000, 2000000};
+  for (uint32_t baud : bauds) runBaud(baud, latencyUs);
+  return 0;
+}
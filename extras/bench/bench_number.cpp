@@ -0,0 +1,120 @@
+// Number conversion benchmark.
+//
+// Compares zap_number's integer and float formatters with Print::print()
+// (the host shim mirrors the Arduino core's digit-at-a-time algorithms), and
+// ArgParser's float parsing with strtof().
+//
+// Usage: zap_bench_number [-n iterations]
+
+#include "Zap.hpp"
+#include "bench.hpp"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+// Counts characters without storing them
+class NullPrint : public ::Print {
+ public:
+  size_t write(uint8_t b) {
+    count_++;
+    return 1;
+  }
+  size_t count_ = 0;
+};
+
+void printHeader(const char *title) {
+  printf("\n%s\n", title);
+  printf("%-34s %12s %12s\n", "case", "Mvalues/s", "ns/value");
+}
+
+template <typename F>
+void run(const char *name, size_t values, size_t iterations, F fn) {
+  bench::Timer t;
+  for (size_t i = 0; i < iterations; i++) fn();
+  double nanos = t.elapsedNanos();
+  double total = (double)values * iterations;
+  printf("%-34s %12.2f %12.1f\n", name, total * 1e3 / nanos, nanos / total);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  size_t iterations = bench::iterations(argc, argv, 2000);
+
+  // Sensor-like readings: a few digits either side of the point
+  std::vector<float> values;
+  for (int i = 0; i < 256; i++) values.push_back((i * 7919 % 20000 - 10000) / 37.0f);
+
+  NullPrint sink;
+  char digits[zap::INT_FORMAT_MAX];
+  char *digitsEnd = digits + sizeof(digits);
+
+  // ADC-like readings and wider counters
+  std::vector<uint16_t> readings;
+  std::vector<uint32_t> counters;
+  for (int i = 0; i < 256; i++) {
+    readings.push_back(i * 7919 % 1024);
+    counters.push_back(i * 2654435761UL % 100000000UL);
+  }
+
+  printHeader("Format uint16_t (0-1023)");
+  run("Print::print(unsigned, DEC)", readings.size(), iterations, [&] {
+    for (uint16_t v : readings) sink.print((unsigned)v, DEC);
+  });
+  run("zap::formatUInt", readings.size(), iterations, [&] {
+    for (uint16_t v : readings) bench::keep(zap::formatUInt(v, digitsEnd));
+  });
+
+  printHeader("Format uint32_t (up to 8 digits)");
+  run("Print::print(unsigned long, DEC)", counters.size(), iterations, [&] {
+    for (uint32_t v : counters) sink.print((unsigned long)v, DEC);
+  });
+  run("zap::formatUInt", counters.size(), iterations, [&] {
+    for (uint32_t v : counters) bench::keep(zap::formatUInt(v, digitsEnd));
+  });
+
+  printHeader("Format float, 4 decimal places");
+  run("Print::print(double, 4)", values.size(), iterations, [&] {
+    for (float v : values) sink.print(v, 4);
+  });
+  char buf[zap::FLOAT_FORMAT_MAX];
+  run("zap::formatFloat", values.size(), iterations, [&] {
+    for (float v : values) bench::keep(zap::formatFloat(v, 4, buf));
+  });
+  bench::keep(sink.count_);
+
+  printHeader("Format float, 2 decimal places");
+  run("Print::print(double, 2)", values.size(), iterations, [&] {
+    for (float v : values) sink.print(v, 2);
+  });
+  run("zap::formatFloat", values.size(), iterations, [&] {
+    for (float v : values) bench::keep(zap::formatFloat(v, 2, buf));
+  });
+
+  // The same values as text, one argument each
+  std::vector<std::string> texts;
+  for (float v : values) {
+    char s[zap::FLOAT_FORMAT_MAX + 1];
+    s[zap::formatFloat(v, 4, s)] = 0;
+    texts.push_back(s);
+  }
+
+  printHeader("Parse float");
+  run("strtof", texts.size(), iterations, [&] {
+    for (const std::string &s : texts) bench::keep(strtof(s.c_str(), nullptr));
+  });
+  std::vector<char> scratch(32);
+  run("zap::ArgParser", texts.size(), iterations, [&] {
+    for (const std::string &s : texts) {
+      memcpy(scratch.data(), s.data(), s.size());
+      zap::ArgParser p(scratch.data(), s.size());
+      zap::Arg arg;
+      p.next(&arg);
+      bench::keep(arg.F);
+    }
+  });
+
+  return 0;
+}
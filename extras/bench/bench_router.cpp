@@ -0,0 +1,153 @@
+// Router benchmark.
+//
+// Puts three simulated devices behind a zap::Router, with in-memory links
+// standing in for the serial ports, and runs a host session against the
+// router: enumeration from the merged catalog, then forwarded requests and
+// reports. Prints the session transcript, then the cost per forwarded
+// request and the number of host round trips needed to enumerate.
+//
+// Usage: zap_bench_router [-n requests]
+
+#include "Zap.hpp"
+#include "bench.hpp"
+#include "memory_link.hpp"
+
+#include <string>
+
+namespace {
+
+const char routerInfo[] PROGMEM =
+    "vendor:\"Test\" product:\"Bench Router\" id:\"com.example.router\"";
+const char deviceInfo[] PROGMEM =
+    "vendor:\"Test\" product:\"Bench Device\" id:\"com.example.bench\"";
+
+class BenchSensor : public zap::ScalarSensorStream<uint16_t> {
+ public:
+  void describe() {
+    proto->writeRaw(F("name:benchSensor class:sensor value:[x] min:0 max:1023"));
+  }
+};
+
+typedef zap::Protocol<4, 96, 64> DeviceProtocol;
+typedef zap::Router<3> BenchRouter;
+
+struct Device {
+  Device(::Stream *port, uint16_t value) : protocol(port, F(deviceInfo)) {
+    protocol.setStreamHandler(1, &sensor1);
+    protocol.setStreamHandler(2, &sensor2);
+    protocol.begin();
+    sensor1.enable();
+    sensor2.enable();
+    sensor1.setValue(value);
+    sensor2.setValue(value + 1);
+  }
+
+  DeviceProtocol protocol;
+  BenchSensor sensor1;
+  BenchSensor sensor2;
+};
+
+struct Rack {
+  Rack()
+      : router(host.b(), F(routerInfo)),
+        a(links[0].b(), 100),
+        b(links[1].b(), 200),
+        c(links[2].b(), 300) {
+    for (int i = 0; i < 3; i++) router.addLink(links[i].a());
+    router.begin();
+  }
+
+  void tick() {
+    router.tick();
+    a.protocol.tick();
+    b.protocol.tick();
+    c.protocol.tick();
+  }
+
+  // Send a line from the host and tick until the router is idle
+  std::string request(const std::string &line) {
+    host.a()->write((const uint8_t *)line.data(), line.size());
+    for (int i = 0; i < 4; i++) tick();
+    return drain();
+  }
+
+  // Everything the router has sent to the host
+  std::string drain() {
+    std::string out;
+    while (host.a()->available() > 0) out += (char)host.a()->read();
+    return out;
+  }
+
+  host::MemoryLink host;
+  host::MemoryLink links[3];
+  BenchRouter router;
+  Device a, b, c;
+};
+
+void transcript(Rack &rack, const char *line) {
+  printf("%s", line);
+  std::string reply = rack.request(line);
+  for (size_t i = 0; i < reply.size(); i++) {
+    if (reply[i] != '\r') putchar(reply[i]);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  size_t n = bench::iterations(argc, argv, 200000);
+
+  host::setMillis(0);
+  Rack rack;
+  int ticks = 0;
+  while (!rack.router.ready()) {
+    rack.tick();
+    ticks++;
+  }
+  printf("Catalog of %d streams ready after %d ticks\n\n", rack.router.routeCount(), ticks);
+
+  transcript(rack, "0<hello\n");
+  transcript(rack, "0<streams\n");
+  for (int id = 1; id <= rack.router.routeCount(); id++) {
+    char line[16];
+    snprintf(line, sizeof(line), "0<desc %d\n", id);
+    transcript(rack, line);
+  }
+  transcript(rack, "3<read\n");
+  transcript(rack, "6<enable\n");
+  transcript(rack, "0<report on 10 2 5\n");
+  host::advanceMillis(10);
+  rack.tick();
+  rack.tick();
+  std::string reports = rack.drain();
+  printf("... 10ms passes ...\n%s", reports.c_str());
+  transcript(rack, "0<report off\n");
+
+  // A host talking to the devices directly needs a streams and a desc
+  // round trip per stream on each device; behind the router it needs one
+  // streams and one desc per stream, all on one port.
+  printf("\nEnumeration round trips: %d direct (3 ports), %d via router (1 port)\n",
+         3 * (1 + 2), 1 + rack.router.routeCount());
+
+  std::string script;
+  for (int id = 1; id <= 6; id++) {
+    char line[16];
+    snprintf(line, sizeof(line), "%d<read\n", id);
+    script += line;
+  }
+  size_t rounds = n / 6;
+  bench::Timer t;
+  for (size_t i = 0; i < rounds; i++) {
+    rack.host.a()->write((const uint8_t *)script.data(), script.size());
+    rack.tick();
+    rack.tick();
+    bench::keep(rack.drain());
+  }
+  double nanos = t.elapsedNanos();
+  size_t requests = rounds * 6;
+  printf("\n%-24s %10s %14s %10s\n", "case", "requests", "requests/sec", "ns/req");
+  printf("%-24s %10zu %14.0f %10.1f\n", "read via router", requests, requests * 1e9 / nanos,
+         nanos / requests);
+
+  return 0;
+}
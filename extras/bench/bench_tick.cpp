@@ -0,0 +1,367 @@
+// Protocol::tick() throughput benchmark.
+//
+// Pushes large scripted sessions through zap::Protocol::tick() over an
+// in-memory port and reports, per command, frames/sec, ns per dispatched
+// frame, and the number of bytes and port write() calls per response.
+//
+// Usage: zap_bench [-n frames]
+
+#include "Zap.hpp"
+#include "bench.hpp"
+#include "cobs_codec.hpp"
+#include "memory_stream.hpp"
+
+namespace {
+
+const char deviceInfo[] PROGMEM =
+    "vendor:\"Test\" product:\"Bench Device\" id:\"com.example.bench\"";
+
+struct BenchConfig {
+  uint16_t min = 0;
+  uint16_t max = 1023;
+  uint16_t interval = 100;
+  int16_t gain = 0;
+};
+
+const char intervalKey[] PROGMEM = "interval";
+const char gainKey[] PROGMEM = "gain";
+
+const zap::ConfigField benchFields[] PROGMEM = {
+    ZAP_CONFIG_KEY(BenchConfig, min, zap::STR_MIN, 0, 1023),
+    ZAP_CONFIG_KEY(BenchConfig, max, zap::STR_MAX, 0, 1023),
+    ZAP_CONFIG_FIELD(BenchConfig, interval, intervalKey, 1, 10000),
+    ZAP_CONFIG_FIELD(BenchConfig, gain, gainKey, -40, 40)};
+
+class BenchSensor : public zap::ScalarSensorStream<uint16_t, BenchConfig> {
+ public:
+  BenchSensor() : zap::ScalarSensorStream<uint16_t, BenchConfig>(benchFields) {}
+  void describe() {
+    proto->writeRaw(F("name:benchSensor class:sensor value:[x] min:0 max:1023"));
+  }
+  void configChanged() { bench::keep(config().gain); }
+};
+
+// Accepts binary frames and acknowledges them with "ok".
+class BlobStream : public zap::Stream {
+ public:
+  void describe() { proto->writeRaw(F("class:blob")); }
+  int handleMessage(uint8_t frameType, char *data, int len) {
+    if (frameType != zap::FRAME_TYPE_BINARY) return zap::STR_ERR_INVALID_ARG;
+    bench::keep(data[len - 1]);
+    return 0;
+  }
+};
+
+typedef zap::Protocol<4, 96> UnbufferedProtocol;
+typedef zap::Protocol<4, 96, 64> BufferedProtocol;
+typedef zap::Protocol<4, 96, 64, true> IncrementalProtocol;
+typedef zap::Protocol<4, 96, 64, false, true> StatsProtocol;
+typedef zap::Protocol<4, 255, 256> TransportProtocol;
+
+template <typename BenchProtocol>
+struct Fixture {
+  Fixture() : protocol(&port, F(deviceInfo)) {
+    port.setTimeout(0);
+    protocol.setStreamHandler(1, &sensor1);
+    protocol.setStreamHandler(2, &sensor2);
+    protocol.setStreamHandler(3, &blob);
+    protocol.begin();
+    sensor1.enable();
+    sensor2.enable();
+    sensor1.setValue(512);
+    sensor2.setValue(1023);
+  }
+
+  host::MemoryStream port;
+  BenchProtocol protocol;
+  BenchSensor sensor1;
+  BenchSensor sensor2;
+  BlobStream blob;
+};
+
+// Feed n copies of frame through tick() and report per-frame figures.
+template <typename P>
+void benchRequest(const char *name, const std::string &frame, size_t n) {
+  Fixture<P> f;
+  std::string script = bench::repeat(frame, n);
+
+  // Warm up and sanity check: every request must produce a reply.
+  f.port.setInput(frame);
+  f.protocol.tick();
+  if (f.port.linesWritten() != 1) {
+    printf("%-24s FAILED: no reply\n", name);
+    return;
+  }
+
+  f.port.setInput(script);
+  f.port.resetCounters();
+
+  bench::Timer t;
+  while (f.port.remaining()) f.protocol.tick();
+  double nanos = t.elapsedNanos();
+
+  bench::printRow(name, n, nanos, f.port.bytesWritten(), f.port.writeCalls());
+}
+
+// Enable reporting on both sensors and tick with the clock advancing 1ms
+// per tick, so that every tick emits one report per stream.
+template <typename P>
+void benchReports(const char *name, const char *enable, size_t n) {
+  Fixture<P> f;
+  host::setMillis(0);
+
+  f.port.setInput(enable);
+  while (f.port.remaining()) f.protocol.tick();
+  f.port.resetCounters();
+
+  size_t ticks = n / 2;
+  bench::Timer t;
+  for (size_t i = 0; i < ticks; i++) {
+    host::advanceMillis(1);
+    f.protocol.tick();
+  }
+  double nanos = t.elapsedNanos();
+
+  bench::printRow(name, f.port.linesWritten(), nanos, f.port.bytesWritten(),
+                  f.port.writeCalls());
+}
+
+// Report ten sensors every tick, one frame per stream or coalesced into a
+// single control stream frame, and compare the wire cost per sample.
+void benchReportFraming(const char *name, bool coalesce, size_t n) {
+  const int sensorCount = 10;
+  host::MemoryStream port;
+  port.setTimeout(0);
+  zap::Protocol<sensorCount, 96, 64> protocol(&port, F(deviceInfo));
+  BenchSensor sensors[sensorCount];
+  for (int i = 0; i < sensorCount; i++) {
+    protocol.setStreamHandler(i + 1, &sensors[i]);
+    sensors[i].enable();
+    sensors[i].setValue(100 + i * 97);
+  }
+
+  host::setMillis(0);
+  port.setInput(coalesce ? "0<report coalesce on\n0<report on 1\n" : "0<report on 1\n");
+  while (port.remaining()) protocol.tick();
+  port.resetCounters();
+
+  size_t ticks = n / sensorCount;
+  bench::Timer t;
+  for (size_t i = 0; i < ticks; i++) {
+    host::advanceMillis(1);
+    protocol.tick();
+  }
+  double nanos = t.elapsedNanos();
+
+  size_t samples = ticks * sensorCount;
+  printf("%-24s %10zu %12.1f %12.1f %12.1f %12.0f\n", name, samples, nanos / samples,
+         (double)port.linesWritten() / ticks, port.bytesWritten() / (double)samples,
+         11520.0 * samples / port.bytesWritten());
+}
+
+class BenchImu : public zap::VectorSensorStream<int16_t, 6> {
+ public:
+  void describe() { proto->writeRaw(F("name:benchImu class:sensor value:[ax ay az gx gy gz]")); }
+};
+
+// Report a six-axis sensor every tick while two of its axes move, in full
+// or as deltas, and compare the wire cost per report.
+void benchDeltaReports(const char *name, const char *policy, size_t n) {
+  host::MemoryStream port;
+  port.setTimeout(0);
+  zap::Protocol<1, 96, 64> protocol(&port, F(deviceInfo));
+  BenchImu imu;
+  protocol.setStreamHandler(1, &imu);
+  imu.enable();
+  int16_t values[6] = {-112, 37, 16384, -3, 2, 11};
+  imu.setValues(values);
+
+  host::setMillis(0);
+  port.setInput(std::string(policy) + "0<report on 1\n");
+  while (port.remaining()) protocol.tick();
+  port.resetCounters();
+
+  bench::Timer t;
+  for (size_t i = 0; i < n; i++) {
+    imu.setValue(2, 16384 + (int16_t)(i % 7));
+    imu.setValue(5, 11 - (int16_t)(i % 5));
+    host::advanceMillis(1);
+    protocol.tick();
+  }
+  double nanos = t.elapsedNanos();
+
+  uint64_t reports = port.linesWritten();
+  printf("%-24s %10llu %12.1f %12.1f %12.0f\n", name, (unsigned long long)reports,
+         nanos / n, port.bytesWritten() / (double)reports,
+         11520.0 * reports / port.bytesWritten());
+}
+
+// Report one sensor every 10ms while the loop runs 1-3ms per tick and
+// stalls for 250ms every 500 ticks, starting just before millis() wraps.
+// Compares the overrun policies by reports sent against the ideal count,
+// the largest burst in one tick, and the worst lateness recorded.
+void benchReportJitter(const char *name, bool catchUp, size_t n) {
+  Fixture<UnbufferedProtocol> f;
+  uint32_t start = 0xFFFFFFFF - 2000;
+  host::setMillis(start);
+  f.port.setInput(catchUp ? "0<report overrun catch-up\n0<report on 10 1\n"
+                          : "0<report on 10 1\n");
+  while (f.port.remaining()) f.protocol.tick();
+  f.port.resetCounters();
+
+  size_t ticks = n / 10;
+  size_t burst = 0;
+  for (size_t i = 0; i < ticks; i++) {
+    host::advanceMillis(i % 500 == 499 ? 250 : 1 + i % 3);
+    size_t before = f.port.linesWritten();
+    f.protocol.tick();
+    size_t sent = f.port.linesWritten() - before;
+    if (sent > burst) burst = sent;
+  }
+
+  zap::DeadlineScheduler<4> &schedule = f.protocol.reportSchedule();
+  uint32_t elapsed = millis() - start;
+  printf("%-24s %10zu %10u %10zu %12u %12u\n", name, f.port.linesWritten(),
+         (unsigned)(elapsed / 10), burst, schedule.maxLateness(0), schedule.skipped(0));
+}
+
+// Report both sensors every 1ms over a link that drains 11 bytes/ms (about
+// 115200 baud) into a 64 byte UART buffer, less than the reports need.
+// The loop's own work takes 1ms per pass. Compares blocking writes with
+// notification headroom by loop rate, the longest gap between passes,
+// and reports delivered.
+void benchBackpressure(const char *name, uint8_t headroom, size_t n) {
+  Fixture<BufferedProtocol> f;
+  host::setMillis(0);
+  f.port.setInput("0<report on 1\n");
+  while (f.port.remaining()) f.protocol.tick();
+  f.protocol.setNotifyHeadroom(headroom);
+  f.port.setTxLink(64, 11);
+  f.port.resetCounters();
+
+  size_t loops = n / 20;
+  uint32_t start = millis();
+  uint32_t maxGap = 0;
+  for (size_t i = 0; i < loops; i++) {
+    uint32_t before = millis();
+    host::advanceMillis(1);
+    f.sensor1.setValue(i & 1023);
+    f.protocol.tick();
+    if (millis() - before > maxGap) maxGap = millis() - before;
+  }
+  double seconds = (millis() - start) / 1000.0;
+
+  printf("%-24s %12.0f %12u %12.0f %12.1f\n", name, loops / seconds, maxGap,
+         f.port.linesWritten() / seconds, f.port.blockedMillis() * 100.0 / (seconds * 1000));
+}
+
+std::string binaryFrame(uint8_t streamID, size_t payloadLen) {
+  std::string frame;
+  frame += zap::toHex(streamID);
+  frame += "<#";
+  for (size_t i = 0; i < payloadLen; i++) {
+    uint8_t b = (uint8_t)(i * 37 + 11);
+    frame += zap::toHex(b >> 4);
+    frame += zap::toHex(b & 0xF);
+  }
+  frame += "\r\n";
+  return frame;
+}
+
+}  // namespace
+
+std::string binaryPayload(size_t len) {
+  std::string payload;
+  for (size_t i = 0; i < len; i++) payload += (char)(i * 37 + 11);
+  return payload;
+}
+
+// Send n binary frames carrying payloadLen bytes each, either hex-encoded
+// in text frames or raw in COBS frames, and compare the wire cost.
+void benchTransport(const char *name, bool cobs, size_t payloadLen, size_t n) {
+  Fixture<TransportProtocol> f;
+
+  if (cobs) {
+    f.port.setInput(std::string("0<transport cobs\n"));
+    f.protocol.tick();
+  }
+
+  std::string frame = cobs ? host::encodeCOBSBinaryFrame(3, binaryPayload(payloadLen))
+                           : binaryFrame(3, payloadLen);
+  std::string script = bench::repeat(frame, n);
+  f.port.setInput(script);
+  f.port.resetCounters();
+
+  bench::Timer t;
+  while (f.port.remaining()) f.protocol.tick();
+  double nanos = t.elapsedNanos();
+
+  // At 115200 baud (8N1) the link carries 11520 bytes/sec
+  double efficiency = (double)payloadLen / frame.size();
+  printf("%-24s %10llu %14.0f %10.1f %12zu %12.1f %12.0f\n", name, (unsigned long long)n,
+         n * 1e9 / nanos, nanos / n, frame.size(), f.port.bytesWritten() / (double)n,
+         11520 * efficiency);
+}
+
+template <typename P>
+void benchCommands(const char *title, size_t n) {
+  bench::printHeader(title);
+  benchRequest<P>("hello", "0<hello\n", n);
+  benchRequest<P>("streams", "0<streams\n", n);
+  benchRequest<P>("desc", "0<desc 1\n", n);
+  benchRequest<P>("read", "1<read\n", n);
+  benchRequest<P>("set", "1<set min:100 max:1000 interval:250 gain:-12\n", n);
+  benchRequest<P>("report on", "0<report on 100 1 2\n", n);
+  benchRequest<P>("report off", "0<report off\n", n);
+  benchReports<P>("report (periodic)", "0<report on 1 1 2\n", n);
+  benchReports<P>("report (mixed rates)", "0<report on 1 1\n0<report on 50 2\n", n);
+  benchRequest<P>("binary 8B", binaryFrame(3, 8), n);
+  benchRequest<P>("binary 40B", binaryFrame(3, 40), n);
+}
+
+int main(int argc, char **argv) {
+  size_t n = bench::iterations(argc, argv, 200000);
+
+  benchCommands<UnbufferedProtocol>("Protocol::tick() by command (unbuffered TX)", n);
+  benchCommands<BufferedProtocol>("Protocol::tick() by command (64 byte TX buffer)", n);
+  benchCommands<IncrementalProtocol>("Protocol::tick() by command (incremental lexing)",
+                                     n);
+  benchCommands<StatsProtocol>("Protocol::tick() by command (64 byte TX buffer, stats)", n);
+
+  printf("\nBinary transport: hex vs COBS\n");
+  printf("%-24s %10s %14s %10s %12s %12s %12s\n", "case", "frames", "frames/sec",
+         "ns/frame", "rx B/frame", "bytes/resp", "B/s@115200");
+  benchTransport("hex 8B", false, 8, n);
+  benchTransport("cobs 8B", true, 8, n);
+  benchTransport("hex 40B", false, 40, n);
+  benchTransport("cobs 40B", true, 40, n);
+  benchTransport("hex 120B", false, 120, n);
+  benchTransport("cobs 120B", true, 120, n);
+
+  printf("\nReport framing: 10 sensors reporting every tick\n");
+  printf("%-24s %10s %12s %12s %12s %12s\n", "case", "samples", "ns/sample", "frames/tick",
+         "B/sample", "samples/s@115200");
+  benchReportFraming("per-stream frames", false, n);
+  benchReportFraming("coalesced", true, n);
+
+  printf("\nDelta reports: 6-axis sensor, 2 axes changing, every tick\n");
+  printf("%-24s %10s %12s %12s %12s\n", "case", "reports", "ns/tick", "B/report",
+         "reports/s@115200");
+  benchDeltaReports("full", "", n);
+  benchDeltaReports("delta, keyframe 10", "1<set delta:true\n", n);
+  benchDeltaReports("delta, keyframe 100", "1<set delta:true keyframe:100\n", n);
+
+  printf("\nReport overrun policy: 10ms reports, 250ms stalls, across millis() wrap\n");
+  printf("%-24s %10s %10s %10s %12s %12s\n", "case", "reports", "ideal", "max burst",
+         "max late ms", "skipped");
+  benchReportJitter("skip", false, n);
+  benchReportJitter("catch-up", true, n);
+
+  printf("\nBackpressure: 2 sensors every 1ms over a 11 B/ms link, 1ms loop\n");
+  printf("%-24s %12s %12s %12s %12s\n", "case", "loops/s", "max gap ms", "reports/s",
+         "% blocked");
+  benchBackpressure("blocking writes", 0, n);
+  benchBackpressure("headroom 32", 32, n);
+
+  return 0;
+}
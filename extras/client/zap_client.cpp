@@ -0,0 +1,372 @@
+#include "zap_client.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace zap {
+
+namespace {
+
+int hexitValue(char ch) {
+  if (ch >= '0' && ch <= '9') return ch - '0';
+  if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+  if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+  return -1;
+}
+
+speed_t baudConstant(int baud) {
+  switch (baud) {
+    case 9600:
+      return B9600;
+    case 19200:
+      return B19200;
+    case 38400:
+      return B38400;
+    case 57600:
+      return B57600;
+    case 115200:
+      return B115200;
+    case 230400:
+      return B230400;
+    case 460800:
+      return B460800;
+    case 921600:
+      return B921600;
+    default:
+      return B0;
+  }
+}
+
+}  // namespace
+
+//
+// Reply
+
+bool Reply::isError() const {
+  const std::string &b = frame.body;
+  return received() && b.compare(0, 5, "error") == 0 &&
+         (b.size() == 5 || b[5] == ':' || b[5] == ' ');
+}
+
+std::string Reply::errorCode() const {
+  if (!isError() || frame.body.size() < 6 || frame.body[5] != ':') return "";
+  size_t end = frame.body.find(' ', 6);
+  return frame.body.substr(6, end == std::string::npos ? std::string::npos : end - 6);
+}
+
+bool applyReport(const Frame &frame, std::vector<std::string> *values) {
+  const std::string &b = frame.body;
+  bool delta = b.compare(0, 8, "report~ ") == 0;
+  if (!delta && b.compare(0, 7, "report ") != 0) return false;
+
+  std::vector<std::string> fields;
+  for (size_t i = delta ? 8 : 7; i <= b.size();) {
+    size_t end = b.find(' ', i);
+    if (end == std::string::npos) end = b.size();
+    fields.push_back(b.substr(i, end - i));
+    i = end + 1;
+  }
+  if (!delta) {
+    values->swap(fields);
+    return true;
+  }
+
+  std::vector<std::pair<size_t, std::string>> updates;
+  for (const std::string &f : fields) {
+    size_t colon = f.find(':');
+    if (colon == 0 || colon == std::string::npos) return false;
+    char *end;
+    size_t ix = strtoul(f.c_str(), &end, 10);
+    if (end != f.c_str() + colon || ix >= values->size()) return false;
+    updates.push_back(std::make_pair(ix, f.substr(colon + 1)));
+  }
+  for (auto &u : updates) (*values)[u.first] = u.second;
+  return true;
+}
+
+//
+// Client
+
+Client::Client(int fd) : fd_(fd) {
+  if (pipe(wakePipe_) != 0) {
+    wakePipe_[0] = wakePipe_[1] = -1;
+  }
+}
+
+Client::~Client() {
+  close();
+  if (wakePipe_[0] >= 0) {
+    ::close(wakePipe_[0]);
+    ::close(wakePipe_[1]);
+  }
+}
+
+int Client::openSerial(const char *path, int baud) {
+  speed_t speed = baudConstant(baud);
+  if (speed == B0) return -1;
+
+  int fd = open(path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+  if (fd < 0) return -1;
+
+  termios tio;
+  if (tcgetattr(fd, &tio) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  cfmakeraw(&tio);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cc[VMIN] = 1;
+  tio.c_cc[VTIME] = 0;
+  cfsetispeed(&tio, speed);
+  cfsetospeed(&tio, speed);
+  if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  tcflush(fd, TCIOFLUSH);
+  return fd;
+}
+
+Reply Client::start() {
+  reader_ = std::thread(&Client::readLoop, this);
+
+  // A device without tag support rejects the tagged hello, untagged
+  Reply hello = call(0, "hello");
+  if (hello.received() && !hello.frame.tagged) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tagged_ = false;
+    }
+    hello = call(0, "hello");
+  }
+  return hello;
+}
+
+void Client::close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_ && !reader_.joinable()) return;
+    closed_ = true;
+    failAllLocked();
+  }
+  if (reader_.joinable()) {
+    char b = 0;
+    if (write(wakePipe_[1], &b, 1) < 0) {
+      // The reader still stops at its next poll timeout
+    }
+    reader_.join();
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+std::future<Reply> Client::request(int stream, const std::string &body) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  pending_.emplace_back();
+  Pending &p = pending_.back();
+  p.stream = stream;
+  p.tag = nextTag_++;
+  p.sent = false;
+  p.body = body;
+  std::future<Reply> reply = p.promise.get_future();
+  if (closed_) {
+    finishLocked(pending_.end() - 1, Reply::CLOSED, Frame());
+  } else {
+    pumpLocked();
+  }
+  return reply;
+}
+
+bool Client::selectExtendedIDs() {
+  Reply reply = call(0, "ids extended");
+  if (!reply.received() || reply.frame.body != "ok") return false;
+  std::lock_guard<std::mutex> lock(mutex_);
+  extendedIDs_ = true;
+  return true;
+}
+
+std::string Client::streamID(int stream) const {
+  char buf[8];
+  if (extendedIDs_ || stream > 15) {
+    snprintf(buf, sizeof(buf), "%d", stream);
+  } else {
+    snprintf(buf, sizeof(buf), "%X", stream);
+  }
+  return buf;
+}
+
+// Write requests that are waiting, oldest first, while the window allows
+void Client::pumpLocked() {
+  for (auto it = pending_.begin(); it != pending_.end() && inFlight_ < window_;) {
+    if (it->sent) {
+      ++it;
+      continue;
+    }
+
+    std::string line = streamID(it->stream);
+    line += '<';
+    if (tagged_) {
+      char tag[8];
+      snprintf(tag, sizeof(tag), "@%X ", it->tag);
+      line += tag;
+    }
+    line += it->body;
+    line += '\n';
+
+    it->sent = true;
+    it->body.clear();
+    it->deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs_);
+    inFlight_++;
+    if (!writeAll(line)) {
+      closed_ = true;
+      failAllLocked();
+      return;
+    }
+    ++it;
+  }
+}
+
+void Client::expireLocked(std::chrono::steady_clock::time_point now) {
+  for (auto it = pending_.begin(); it != pending_.end();) {
+    if (it->sent && now >= it->deadline) {
+      finishLocked(it, Reply::TIMEOUT, Frame());
+      it = pending_.begin();
+    } else {
+      ++it;
+    }
+  }
+}
+
+void Client::finishLocked(std::deque<Pending>::iterator it, Reply::Status status,
+                          const Frame &frame) {
+  Reply reply;
+  reply.status = status;
+  reply.frame = frame;
+  if (it->sent) inFlight_--;
+  it->promise.set_value(reply);
+  pending_.erase(it);
+}
+
+void Client::failAllLocked() {
+  while (!pending_.empty()) {
+    finishLocked(pending_.begin(), Reply::CLOSED, Frame());
+  }
+}
+
+bool Client::writeAll(const std::string &data) {
+  size_t done = 0;
+  while (done < data.size()) {
+    ssize_t n = write(fd_, data.data() + done, data.size() - done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    done += n;
+  }
+  return true;
+}
+
+void Client::readLoop() {
+  std::string buf;
+  char chunk[256];
+  while (true) {
+    pollfd fds[2] = {{fd_, POLLIN, 0}, {wakePipe_[0], POLLIN, 0}};
+    int n = poll(fds, wakePipe_[0] >= 0 ? 2 : 1, 20);
+    if (n < 0 && errno != EINTR) break;
+    if (n > 0 && (fds[1].revents & POLLIN)) break;
+
+    if (n > 0 && (fds[0].revents & (POLLIN | POLLHUP | POLLERR))) {
+      ssize_t r = read(fd_, chunk, sizeof(chunk));
+      if (r < 0 && errno == EINTR) continue;
+      if (r <= 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        failAllLocked();
+        return;
+      }
+      buf.append(chunk, r);
+
+      size_t start = 0;
+      size_t end;
+      while ((end = buf.find_first_of("\r\n", start)) != std::string::npos) {
+        if (end > start) handleLine(buf.data() + start, end - start);
+        start = end + 1;
+      }
+      buf.erase(0, start);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) return;
+    expireLocked(std::chrono::steady_clock::now());
+    pumpLocked();
+  }
+}
+
+void Client::handleLine(const char *line, size_t len) {
+  Frame frame;
+  int tag;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!parseFrame(line, len, &frame, &tag)) return;
+
+    if (frame.type == '>') {
+      // Match the tag, or else the oldest request sent to the stream
+      for (auto it = pending_.begin(); it != pending_.end(); ++it) {
+        if (!it->sent) continue;
+        if (frame.tagged ? it->tag == tag : it->stream == frame.stream) {
+          finishLocked(it, Reply::RECEIVED, frame);
+          break;
+        }
+      }
+      pumpLocked();
+      return;
+    }
+  }
+
+  if (frame.type == '!' && onNotify_) {
+    onNotify_(frame);
+  }
+}
+
+bool Client::parseFrame(const char *line, size_t len, Frame *frame, int *tag) const {
+  size_t i = 0;
+  if (extendedIDs_) {
+    int id = 0;
+    while (i < len && line[i] >= '0' && line[i] <= '9' && id <= 0xFF) {
+      id = id * 10 + line[i++] - '0';
+    }
+    if (i == 0 || id > 0xFF) return false;
+    frame->stream = id;
+  } else {
+    frame->stream = hexitValue(line[0]);
+    if (frame->stream < 0) return false;
+    i = 1;
+  }
+  if (i >= len) return false;
+  frame->type = line[i++];
+
+  // "@<tag> "
+  frame->tagged = false;
+  if (i < len && line[i] == '@') {
+    size_t j = i + 1;
+    int value = 0;
+    while (j < len && hexitValue(line[j]) >= 0 && j - i <= 4) {
+      value = value << 4 | hexitValue(line[j++]);
+    }
+    if (j > i + 1 && (j == len || line[j] == ' ')) {
+      frame->tagged = true;
+      *tag = value;
+      i = j < len ? j + 1 : j;
+    }
+  }
+
+  frame->body.assign(line + i, len - i);
+  return true;
+}
+
+}  // namespace zap
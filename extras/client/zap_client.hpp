@@ -0,0 +1,158 @@
+#pragma once
+
+// Host-side client for zap devices, for Linux.
+//
+// Client talks to one device over a file descriptor: a serial port opened
+// with openSerial(), a socket, or a pty. Requests are written as soon as
+// they are made, up to a window of requests in flight, and each returns a
+// std::future that is completed when its reply arrives. A reader thread
+// matches replies to requests and passes notifications to a handler.
+//
+// Replies are matched by request tag ("1<@2F read" / "1>@2F read 512"),
+// so they may arrive in any order. Devices that predate tags are detected
+// by start(); replies from them are matched to the oldest request on the
+// same stream instead, which relies on the device answering in order.
+//
+// Only the text transport is supported.
+
+#include <stdint.h>
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace zap {
+
+// A frame received from the device
+struct Frame {
+  int stream = -1;      // stream ID
+  char type = 0;        // '>' for a reply, '!' for a notification
+  bool tagged = false;  // the reply carried a request tag
+  std::string body;     // frame body, without the header and tag
+};
+
+// The outcome of a request
+struct Reply {
+  enum Status {
+    RECEIVED,  // the device replied; see frame
+    TIMEOUT,   // no reply within the client's timeout
+    CLOSED     // the client was closed, or the link failed
+  };
+
+  Status status = CLOSED;
+  Frame frame;
+
+  bool received() const { return status == RECEIVED; }
+
+  // True if the device replied with an error
+  bool isError() const;
+
+  // The error code of an error reply ("invalid-arg"), or ""
+  std::string errorCode() const;
+};
+
+// Apply a report notification to values, the stream's values as of its
+// last report. A full report ("report 120 -4 998") replaces them and a
+// delta ("report~ 1:-9") updates the ones it names. Returns false, leaving
+// values as they were, if the frame is not a report or is a delta naming
+// a value not yet known; the next full report brings values up to date.
+// Values are taken to be separated by single spaces.
+bool applyReport(const Frame &frame, std::vector<std::string> *values);
+
+class Client {
+ public:
+  typedef std::function<void(const Frame &)> NotificationHandler;
+
+  // Take over fd, which is closed with the client
+  explicit Client(int fd);
+  ~Client();
+
+  Client(const Client &) = delete;
+  Client &operator=(const Client &) = delete;
+
+  // Open a serial port in raw mode at baud (e.g. 115200), returning a file
+  // descriptor, or -1 on error
+  static int openSerial(const char *path, int baud);
+
+  // Configuration; change only while no requests are in flight
+
+  // Time allowed for each reply, from when its request is written (ms)
+  void setTimeout(int ms) { timeoutMs_ = ms; }
+
+  // Most requests written but not yet answered. Later requests wait their
+  // turn, so that the device's receive buffer is not overrun.
+  void setWindow(int requests) { window_ = requests > 0 ? requests : 1; }
+
+  // Called on the reader thread for each notification
+  void setNotificationHandler(NotificationHandler handler) { onNotify_ = handler; }
+
+  // Start the reader thread and greet the device with "hello", which also
+  // finds out whether it echoes request tags. Returns the hello reply.
+  Reply start();
+
+  // Stop the reader thread and close the descriptor. Requests not yet
+  // answered complete with Reply::CLOSED.
+  void close();
+
+  // Send body to stream and return the future reply
+  std::future<Reply> request(int stream, const std::string &body);
+
+  // Send body to stream and wait for the reply
+  Reply call(int stream, const std::string &body) { return request(stream, body).get(); }
+
+  // Select extended stream IDs on the device ("ids extended"), so that
+  // streams above 15 can be reached. No other requests may be in flight.
+  bool selectExtendedIDs();
+
+  // Format a stream ID as the device expects it in arguments
+  std::string streamID(int stream) const;
+
+  // True if the device echoes request tags
+  bool tagged() const { return tagged_; }
+
+ private:
+  struct Pending {
+    int stream;
+    uint16_t tag;
+    bool sent;
+    std::string body;  // kept until the request is sent
+    std::chrono::steady_clock::time_point deadline;
+    std::promise<Reply> promise;
+  };
+
+  void readLoop();
+  void handleLine(const char *line, size_t len);
+  bool parseFrame(const char *line, size_t len, Frame *frame, int *tag) const;
+  void pumpLocked();
+  void expireLocked(std::chrono::steady_clock::time_point now);
+  void finishLocked(std::deque<Pending>::iterator it, Reply::Status status,
+                    const Frame &frame);
+  void failAllLocked();
+  bool writeAll(const std::string &data);
+
+  int fd_;
+  int wakePipe_[2];  // written by close() to wake the reader
+  std::thread reader_;
+  std::mutex mutex_;
+
+  int timeoutMs_ = 1000;
+  int window_ = 4;
+  bool tagged_ = true;
+  bool extendedIDs_ = false;
+  bool closed_ = false;
+  uint16_t nextTag_ = 0;
+  int inFlight_ = 0;
+
+  // Requests in the order they were made; those not yet sent wait behind
+  // the window
+  std::deque<Pending> pending_;
+
+  NotificationHandler onNotify_;
+};
+
+}  // namespace zap
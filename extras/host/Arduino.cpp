@@ -0,0 +1,190 @@
+#include "Arduino.h"
+
+#include <math.h>
+
+//
+// Print
+//
+// Number formatting mirrors the AVR core so that host measurements of the
+// print() paths are representative of what runs on the boards.
+
+size_t Print::print(const __FlashStringHelper *ifsh) {
+  const char *p = reinterpret_cast<const char *>(ifsh);
+  size_t n = 0;
+  while (1) {
+    unsigned char c = pgm_read_byte(p++);
+    if (c == 0) break;
+    if (write(c)) {
+      n++;
+    } else {
+      break;
+    }
+  }
+  return n;
+}
+
+size_t Print::print(const char str[]) { return write(str); }
+
+size_t Print::print(char c) { return write((uint8_t)c); }
+
+size_t Print::print(unsigned char b, int base) { return print((unsigned long)b, base); }
+
+size_t Print::print(int n, int base) { return print((long)n, base); }
+
+size_t Print::print(unsigned int n, int base) { return print((unsigned long)n, base); }
+
+size_t Print::print(long n, int base) {
+  if (base == 0) {
+    return write((uint8_t)n);
+  } else if (base == 10) {
+    if (n < 0) {
+      int t = print('-');
+      n = -n;
+      return printNumber(n, 10) + t;
+    }
+    return printNumber(n, 10);
+  } else {
+    return printNumber(n, base);
+  }
+}
+
+size_t Print::print(unsigned long n, int base) {
+  if (base == 0) return write((uint8_t)n);
+  return printNumber(n, base);
+}
+
+size_t Print::print(double n, int digits) { return printFloat(n, digits); }
+
+size_t Print::println() { return write("\r\n"); }
+
+size_t Print::println(const char c[]) {
+  size_t n = print(c);
+  return n + println();
+}
+
+size_t Print::printNumber(unsigned long n, uint8_t base) {
+  char buf[8 * sizeof(long) + 1];
+  char *str = &buf[sizeof(buf) - 1];
+
+  *str = '\0';
+
+  if (base < 2) base = 10;
+
+  do {
+    char c = n % base;
+    n /= base;
+    *--str = c < 10 ? c + '0' : c + 'A' - 10;
+  } while (n);
+
+  return write(str);
+}
+
+size_t Print::printFloat(double number, uint8_t digits) {
+  size_t n = 0;
+
+  if (isnan(number)) return print("nan");
+  if (isinf(number)) return print("inf");
+  if (number > 4294967040.0) return print("ovf");
+  if (number < -4294967040.0) return print("ovf");
+
+  if (number < 0.0) {
+    n += print('-');
+    number = -number;
+  }
+
+  double rounding = 0.5;
+  for (uint8_t i = 0; i < digits; ++i) rounding /= 10.0;
+  number += rounding;
+
+  unsigned long int_part = (unsigned long)number;
+  double remainder = number - (double)int_part;
+  n += print(int_part);
+
+  if (digits > 0) {
+    n += print('.');
+  }
+
+  while (digits-- > 0) {
+    remainder *= 10.0;
+    unsigned int toPrint = (unsigned int)(remainder);
+    n += print(toPrint);
+    remainder -= toPrint;
+  }
+
+  return n;
+}
+
+//
+// Stream
+
+size_t Stream::readBytes(char *buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+    int c = read();
+    if (c < 0) break;
+    *buffer++ = (char)c;
+    count++;
+  }
+  return count;
+}
+
+//
+// Serial
+
+HardwareSerial Serial;
+
+static ::Stream *serialPort = nullptr;
+
+int HardwareSerial::available() { return serialPort ? serialPort->available() : 0; }
+int HardwareSerial::read() { return serialPort ? serialPort->read() : -1; }
+int HardwareSerial::peek() { return serialPort ? serialPort->peek() : -1; }
+
+size_t HardwareSerial::readBytes(char *buffer, size_t length) {
+  return serialPort ? serialPort->readBytes(buffer, length) : 0;
+}
+
+size_t HardwareSerial::write(uint8_t b) { return serialPort ? serialPort->write(b) : 1; }
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  return serialPort ? serialPort->write(buffer, size) : size;
+}
+
+int HardwareSerial::availableForWrite() {
+  return serialPort ? serialPort->availableForWrite() : 0;
+}
+
+//
+// Timing
+
+static unsigned long currentMillis = 0;
+
+unsigned long millis() { return currentMillis; }
+unsigned long micros() { return currentMillis * 1000; }
+void delay(unsigned long ms) { currentMillis += ms; }
+
+//
+// GPIO
+
+static int digitalPins[256];
+static int analogPins[256];
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (mode == INPUT_PULLUP) digitalPins[pin] = HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) { digitalPins[pin] = val ? HIGH : LOW; }
+int digitalRead(uint8_t pin) { return digitalPins[pin]; }
+int analogRead(uint8_t pin) { return analogPins[pin]; }
+
+namespace host {
+
+void setMillis(unsigned long ms) { currentMillis = ms; }
+void advanceMillis(unsigned long ms) { currentMillis += ms; }
+
+void attachSerial(::Stream *port) { serialPort = port; }
+
+void setDigitalPin(uint8_t pin, int val) { digitalPins[pin] = val ? HIGH : LOW; }
+int digitalPin(uint8_t pin) { return digitalPins[pin]; }
+void setAnalogPin(uint8_t pin, int val) { analogPins[pin] = val; }
+
+};  // namespace host
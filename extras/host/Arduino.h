@@ -0,0 +1,166 @@
+#pragma once
+
+// Minimal stand-in for the Arduino core, sufficient to build the zap
+// library natively on Linux. Only the parts of the API that the library
+// (and its examples) actually touch are provided; behaviour follows the
+// AVR core wherever it is observable on the wire.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <avr/pgmspace.h>
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define LED_BUILTIN 13
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+//
+// Print
+
+class Print {
+ public:
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t) = 0;
+
+  // Default implementation writes byte-by-byte, as the AVR core does.
+  virtual size_t write(const uint8_t *buffer, size_t size) {
+    size_t n = 0;
+    while (size--) {
+      if (write(*buffer++)) {
+        n++;
+      } else {
+        break;
+      }
+    }
+    return n;
+  }
+
+  size_t write(const char *str) {
+    if (str == nullptr) return 0;
+    return write((const uint8_t *)str, strlen(str));
+  }
+
+  size_t write(const char *buffer, size_t size) {
+    return write((const uint8_t *)buffer, size);
+  }
+
+  // Number of bytes that can be written without blocking; 0 means unknown.
+  virtual int availableForWrite() { return 0; }
+
+  virtual void flush() {}
+
+  size_t print(const __FlashStringHelper *);
+  size_t print(const char[]);
+  size_t print(char);
+  size_t print(unsigned char, int = DEC);
+  size_t print(int, int = DEC);
+  size_t print(unsigned int, int = DEC);
+  size_t print(long, int = DEC);
+  size_t print(unsigned long, int = DEC);
+  size_t print(double, int = 2);
+
+  size_t println();
+  size_t println(const char[]);
+
+ private:
+  size_t printNumber(unsigned long, uint8_t);
+  size_t printFloat(double, uint8_t);
+};
+
+//
+// Stream
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout) { timeout_ = timeout; }
+  unsigned long getTimeout() const { return timeout_; }
+
+  // Read up to length bytes into buffer, returning the number of bytes read.
+  // The host clock does not advance while waiting so, unlike on hardware,
+  // this returns as soon as the underlying stream runs dry.
+  virtual size_t readBytes(char *buffer, size_t length);
+  size_t readBytes(uint8_t *buffer, size_t length) {
+    return readBytes((char *)buffer, length);
+  }
+
+ protected:
+  unsigned long timeout_ = 1000;
+};
+
+//
+// Serial
+//
+// Serial forwards to the ::Stream given to host::attachSerial(), so that
+// a sketch can run unmodified on the host. Until one is attached it reads
+// nothing and discards writes.
+
+class HardwareSerial : public Stream {
+ public:
+  void begin(unsigned long) {}
+  void end() {}
+  operator bool() { return true; }
+
+  int available();
+  int read();
+  int peek();
+  size_t readBytes(char *buffer, size_t length);
+  size_t write(uint8_t b);
+  size_t write(const uint8_t *buffer, size_t size);
+  int availableForWrite();
+
+  using Print::write;
+  using Stream::readBytes;
+};
+
+extern HardwareSerial Serial;
+
+//
+// Timing
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+//
+// GPIO
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+namespace host {
+
+// The host clock is virtual: millis() only moves when advanced explicitly,
+// which keeps benchmarks and simulations deterministic.
+void setMillis(unsigned long ms);
+void advanceMillis(unsigned long ms);
+
+// Connect Serial to port, or disconnect it if port is null
+void attachSerial(::Stream *port);
+
+// Simulated pin state, as seen by digitalRead()/analogRead().
+void setDigitalPin(uint8_t pin, int val);
+int digitalPin(uint8_t pin);
+void setAnalogPin(uint8_t pin, int val);
+
+};  // namespace host
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Zap.hpp"
+
+#include <string>
+#include <vector>
+
+namespace host {
+
+// Host-side encoder/decoder for the COBS transport (see zap_cobs.hpp).
+// Frames are handled in their text form minus the trailing newline,
+// e.g. "0<hello" or "3<#" followed by raw binary bytes.
+
+// Encode a frame, appending the CRC and the 0x00 delimiter.
+inline std::string encodeCOBSFrame(const std::string &frame) {
+  std::string raw = frame;
+  uint16_t crc = zap::crc16((const uint8_t *)raw.data(), raw.size());
+  raw += (char)(crc >> 8);
+  raw += (char)(crc & 0xFF);
+
+  std::string out(zap::cobsMaxEncodedLength(raw.size()) + 1, '\0');
+  size_t n = zap::cobsEncode((const uint8_t *)raw.data(), raw.size(), (uint8_t *)&out[0]);
+  out.resize(n + 1);  // keep the delimiter
+  return out;
+}
+
+// Build a binary frame for streamID carrying payload.
+inline std::string encodeCOBSBinaryFrame(uint8_t streamID, const std::string &payload) {
+  std::string frame;
+  frame += zap::toHex(streamID);
+  frame += "<#";
+  frame += payload;
+  return encodeCOBSFrame(frame);
+}
+
+// Incremental decoder for a COBS byte stream. Complete frames that pass
+// the CRC check are appended to frames; corrupt ones are counted and
+// skipped.
+class COBSDecoder {
+ public:
+  void feed(const char *data, size_t len, std::vector<std::string> &frames) {
+    for (size_t i = 0; i < len; i++) {
+      if (data[i] != 0) {
+        pending_ += data[i];
+        continue;
+      }
+      int n = zap::cobsDecode((uint8_t *)&pending_[0], pending_.size());
+      if (n >= 2 && zap::crc16((const uint8_t *)pending_.data(), n - 2) ==
+                        (((uint8_t)pending_[n - 2] << 8) | (uint8_t)pending_[n - 1])) {
+        frames.push_back(pending_.substr(0, n - 2));
+      } else if (!pending_.empty()) {
+        errors_++;
+      }
+      pending_.clear();
+    }
+  }
+
+  void feed(const std::string &data, std::vector<std::string> &frames) {
+    feed(data.data(), data.size(), frames);
+  }
+
+  size_t errors() const { return errors_; }
+
+ private:
+  std::string pending_;
+  size_t errors_ = 0;
+};
+
+};  // namespace host
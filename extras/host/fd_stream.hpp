@@ -0,0 +1,95 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace host {
+
+// FdStream is a ::Stream over a file descriptor, such as one end of a
+// socketpair() or the slave side of a pty, so that a device can run on
+// the host and talk to a real client. Reads never block; writes block
+// until the descriptor has taken every byte.
+class FdStream : public ::Stream {
+ public:
+  explicit FdStream(int fd) : fd_(fd) {}
+
+  int fd() const { return fd_; }
+
+  // Wait up to ms for input to arrive; returns true if there is some
+  bool waitForInput(int ms) {
+    if (peek_ >= 0) return true;
+    pollfd p = {fd_, POLLIN, 0};
+    return poll(&p, 1, ms) > 0 && (p.revents & POLLIN);
+  }
+
+  int available() {
+    int n = 0;
+    if (ioctl(fd_, FIONREAD, &n) != 0) n = 0;
+    return n + (peek_ >= 0 ? 1 : 0);
+  }
+
+  int read() {
+    if (peek_ >= 0) {
+      int b = peek_;
+      peek_ = -1;
+      return b;
+    }
+    uint8_t b;
+    return available() > 0 && readSome((char *)&b, 1) == 1 ? b : -1;
+  }
+
+  int peek() {
+    if (peek_ < 0 && available() > 0) {
+      uint8_t b;
+      if (readSome((char *)&b, 1) == 1) peek_ = b;
+    }
+    return peek_;
+  }
+
+  size_t readBytes(char *buffer, size_t length) {
+    size_t n = 0;
+    if (length > 0 && peek_ >= 0) {
+      buffer[n++] = (char)peek_;
+      peek_ = -1;
+    }
+    if (n < length && available() > 0) {
+      ssize_t r = readSome(buffer + n, length - n);
+      if (r > 0) n += r;
+    }
+    return n;
+  }
+
+  size_t write(uint8_t b) { return write(&b, 1); }
+
+  size_t write(const uint8_t *buffer, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+      ssize_t n = ::write(fd_, buffer + done, size - done);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) break;
+      done += n;
+    }
+    return done;
+  }
+
+  using ::Print::write;
+  using ::Stream::readBytes;
+
+ private:
+  ssize_t readSome(char *buffer, size_t length) {
+    ssize_t n;
+    do {
+      n = ::read(fd_, buffer, length);
+    } while (n < 0 && errno == EINTR);
+    return n;
+  }
+
+  int fd_;
+  int peek_ = -1;  // byte read by peek(), or -1
+};
+
+};  // namespace host
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <deque>
+
+namespace host {
+
+// MemoryLink is an in-memory serial cable: two ::Stream endpoints, each
+// reading what the other writes. It stands in for the link between a
+// router and a downstream device, or between a host and a device, when
+// both ends run in the same process.
+class MemoryLink {
+ public:
+  class End : public ::Stream {
+   public:
+    End(std::deque<uint8_t> *rx, std::deque<uint8_t> *tx) : rx_(rx), tx_(tx) {}
+
+    int available() { return (int)rx_->size(); }
+
+    int read() {
+      if (rx_->empty()) return -1;
+      uint8_t b = rx_->front();
+      rx_->pop_front();
+      return b;
+    }
+
+    int peek() { return rx_->empty() ? -1 : rx_->front(); }
+
+    size_t readBytes(char *buffer, size_t length) {
+      size_t n = 0;
+      while (n < length && !rx_->empty()) {
+        buffer[n++] = (char)rx_->front();
+        rx_->pop_front();
+      }
+      return n;
+    }
+
+    size_t write(uint8_t b) {
+      tx_->push_back(b);
+      return 1;
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) {
+      tx_->insert(tx_->end(), buffer, buffer + size);
+      return size;
+    }
+
+    using ::Print::write;
+    using ::Stream::readBytes;
+
+   private:
+    std::deque<uint8_t> *rx_;
+    std::deque<uint8_t> *tx_;
+  };
+
+  MemoryLink() : a_(&ba_, &ab_), b_(&ab_, &ba_) {}
+
+  // The two ends of the link
+  End *a() { return &a_; }
+  End *b() { return &b_; }
+
+ private:
+  std::deque<uint8_t> ab_;  // written by a, read by b
+  std::deque<uint8_t> ba_;  // written by b, read by a
+  End a_;
+  End b_;
+};
+
+};  // namespace host
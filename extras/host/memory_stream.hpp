@@ -0,0 +1,171 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <string>
+
+namespace host {
+
+// MemoryStream is a ::Stream backed by in-memory buffers. Input is served
+// from a script supplied by the caller; output is counted and, optionally,
+// captured for inspection.
+//
+// Bulk writes are accepted in a single call (as USB-CDC serial ports do)
+// and counted separately from single-byte writes, so the number of port
+// calls per frame can be measured.
+class MemoryStream : public ::Stream {
+ public:
+  MemoryStream() {}
+
+  // Replace the input script with a copy of data.
+  void setInput(const char *data, size_t len) { setInput(std::string(data, len)); }
+
+  void setInput(const std::string &data) {
+    rxData_ = data;
+    rx_ = rxData_.data();
+    rxLen_ = rxData_.size();
+    rxPos_ = 0;
+  }
+
+  // Limit the number of bytes reported by available() at any one time,
+  // simulating input that trickles in between ticks. 0 means unlimited.
+  void setChunkSize(size_t n) { chunk_ = n; }
+
+  size_t remaining() const { return rxLen_ - rxPos_; }
+
+  // Output capture is off by default to keep benchmark overhead down.
+  void setCapture(bool capture) { capture_ = capture; }
+  const std::string &output() const { return tx_; }
+  void clearOutput() { tx_.clear(); }
+
+  // Model a transmit buffer of capacity bytes that drains at bytesPerMs
+  // against the virtual clock, as a UART does. availableForWrite() then
+  // reports the free space, and a write that does not fit blocks, moving
+  // the clock on until it does. A capacity of 0 (the default) accepts
+  // every write at once.
+  void setTxLink(size_t capacity, size_t bytesPerMs) {
+    txCapacity_ = capacity;
+    txRate_ = bytesPerMs;
+    txQueued_ = 0;
+    txDrainedAt_ = millis();
+  }
+
+  // Time spent blocked in write(), in ms
+  uint64_t blockedMillis() const { return blockedMillis_; }
+
+  // Output counters
+  uint64_t bytesWritten() const { return bytesWritten_; }
+  uint64_t writeCalls() const { return writeCalls_; }
+  uint64_t linesWritten() const { return linesWritten_; }
+
+  void resetCounters() {
+    bytesWritten_ = 0;
+    writeCalls_ = 0;
+    linesWritten_ = 0;
+    blockedMillis_ = 0;
+  }
+
+  //
+  // ::Stream
+
+  int available() {
+    size_t n = remaining();
+    if (chunk_ > 0 && n > chunk_) n = chunk_;
+    return (int)n;
+  }
+
+  int read() {
+    if (rxPos_ >= rxLen_) return -1;
+    return (uint8_t)rx_[rxPos_++];
+  }
+
+  int peek() {
+    if (rxPos_ >= rxLen_) return -1;
+    return (uint8_t)rx_[rxPos_];
+  }
+
+  size_t readBytes(char *buffer, size_t length) {
+    size_t n = (size_t)available();
+    if (n > length) n = length;
+    memcpy(buffer, rx_ + rxPos_, n);
+    rxPos_ += n;
+    return n;
+  }
+
+  int availableForWrite() {
+    if (txCapacity_ == 0) return 0;
+    drain();
+    return (int)(txCapacity_ - txQueued_);
+  }
+
+  size_t write(uint8_t b) {
+    enqueue(1);
+    writeCalls_++;
+    bytesWritten_++;
+    if (b == '\n') linesWritten_++;
+    if (capture_) tx_.push_back((char)b);
+    return 1;
+  }
+
+  size_t write(const uint8_t *buffer, size_t size) {
+    enqueue(size);
+    writeCalls_++;
+    bytesWritten_ += size;
+    for (size_t i = 0; i < size; i++) {
+      if (buffer[i] == '\n') linesWritten_++;
+    }
+    if (capture_) tx_.append((const char *)buffer, size);
+    return size;
+  }
+
+  using ::Print::write;
+  using ::Stream::readBytes;
+
+ private:
+  void drain() {
+    unsigned long now = millis();
+    size_t drained = (now - txDrainedAt_) * txRate_;
+    txQueued_ = drained < txQueued_ ? txQueued_ - drained : 0;
+    txDrainedAt_ = now;
+  }
+
+  // Queue n bytes on the modelled link, blocking while it is full
+  void enqueue(size_t n) {
+    if (txCapacity_ == 0) return;
+    drain();
+    while (n > 0) {
+      if (txQueued_ == txCapacity_) {
+        host::advanceMillis(1);
+        blockedMillis_++;
+        drain();
+        continue;
+      }
+      size_t take = txCapacity_ - txQueued_;
+      if (take > n) take = n;
+      txQueued_ += take;
+      n -= take;
+    }
+  }
+
+  std::string rxData_;
+  const char *rx_ = nullptr;
+  size_t rxLen_ = 0;
+  size_t rxPos_ = 0;
+  size_t chunk_ = 0;
+
+  bool capture_ = false;
+  std::string tx_;
+
+  uint64_t bytesWritten_ = 0;
+  uint64_t writeCalls_ = 0;
+  uint64_t linesWritten_ = 0;
+
+  // Modelled transmit link
+  size_t txCapacity_ = 0;
+  size_t txRate_ = 0;
+  size_t txQueued_ = 0;
+  unsigned long txDrainedAt_ = 0;
+  uint64_t blockedMillis_ = 0;
+};
+
+};  // namespace host
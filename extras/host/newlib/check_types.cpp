@@ -0,0 +1,15 @@
+// Instantiates the library's templates so that the zap_check_newlib target
+// compiles all of their members against newlib's integer types.
+
+#include "Zap.hpp"
+
+template class zap::Protocol<4, 96>;
+template class zap::Protocol<4, 96, 64, true, true>;
+template class zap::Router<3>;
+template class zap::ScalarSensorStream<int>;
+template class zap::ScalarSensorStream<int16_t>;
+template class zap::ScalarSensorStream<uint32_t>;
+template class zap::ScalarSensorStream<float>;
+template class zap::VectorSensorStream<int, 3>;
+template class zap::VectorSensorStream<int32_t, 6>;
+template class zap::CaptureStream<int16_t, 64>;
@@ -0,0 +1,21 @@
+#pragma once
+
+// Fixed-width types as newlib (ARM Cortex-M and other embedded toolchains)
+// defines them, with int32_t as long rather than int. Force-included by the
+// zap_check_newlib target so that the host build catches calls that only
+// resolve when int32_t is int. Compile-only: on 64-bit hosts long is wider
+// than 32 bits.
+
+#define _BITS_STDINT_INTN_H 1
+#define _BITS_STDINT_UINTN_H 1
+
+typedef signed char int8_t;
+typedef short int16_t;
+typedef long int32_t;
+typedef long long int64_t;
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned long uint32_t;
+typedef unsigned long long uint64_t;
+
+#include_next <stdint.h>
@@ -0,0 +1,72 @@
+#pragma once
+
+// Runs an Arduino sketch on a thread of its own, with Serial attached to
+// the device end of a simulated link.
+
+#include "serial_link.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace sim {
+
+// DeviceRunner calls the sketch's setup() on start(), as a board does at
+// reset, and then loop() until stopped. millis() follows real time, so that report periods mean what
+// they would on a board, and inputs(ms) is called before each pass of the
+// loop to update simulated pins. Between passes the runner waits briefly
+// for input rather than spinning.
+//
+// Sketches keep their state in globals, so only one runner may be started
+// at a time.
+class DeviceRunner {
+ public:
+  typedef void (*SketchFn)();
+  typedef void (*InputsFn)(unsigned long ms);
+
+  DeviceRunner(SerialLink *link, SketchFn setup, SketchFn loop, InputsFn inputs = nullptr)
+      : link_(link), setup_(setup), loop_(loop), inputs_(inputs) {}
+
+  ~DeviceRunner() { stop(); }
+
+  void start() {
+    stop_ = false;
+    host::attachSerial(link_->device());
+    thread_ = std::thread(&DeviceRunner::run, this);
+  }
+
+  void stop() {
+    stop_ = true;
+    if (thread_.joinable()) thread_.join();
+    host::attachSerial(nullptr);
+  }
+
+ private:
+  void run() {
+    auto t0 = std::chrono::steady_clock::now();
+    auto elapsedMs = [t0] {
+      return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+                 std::chrono::steady_clock::now() - t0)
+          .count();
+    };
+
+    host::setMillis(0);
+    setup_();
+    while (!stop_) {
+      unsigned long ms = elapsedMs();
+      host::setMillis(ms);
+      if (inputs_) inputs_(ms);
+      loop_();
+      link_->waitForInput(200);
+    }
+  }
+
+  SerialLink *link_;
+  SketchFn setup_;
+  SketchFn loop_;
+  InputsFn inputs_;
+  std::atomic<bool> stop_{false};
+  std::thread thread_;
+};
+
+}  // namespace sim
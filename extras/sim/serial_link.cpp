@@ -0,0 +1,212 @@
+#include "serial_link.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <chrono>
+
+namespace sim {
+
+SerialLink::SerialLink(const LinkConfig &config)
+    : config_(config),
+      byteNs_(10 * 1000000000ULL / (config.baud > 0 ? config.baud : 1)),
+      device_(this) {}
+
+SerialLink::~SerialLink() { close(); }
+
+int SerialLink::openSocket() {
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0) return -1;
+  start(sv[0]);
+  return sv[1];
+}
+
+std::string SerialLink::openPty() {
+  int master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+  if (master < 0) return "";
+  if (grantpt(master) != 0 || unlockpt(master) != 0) {
+    ::close(master);
+    return "";
+  }
+  std::string path = ptsname(master);
+
+  // Raw mode, so that the line discipline passes frames through untouched
+  int slave = ::open(path.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+  termios tio;
+  if (slave < 0 || tcgetattr(slave, &tio) != 0) {
+    if (slave >= 0) ::close(slave);
+    ::close(master);
+    return "";
+  }
+  cfmakeraw(&tio);
+  tcsetattr(slave, TCSANOW, &tio);
+  ptySlave_ = slave;
+
+  start(master);
+  return path;
+}
+
+void SerialLink::start(int fd) {
+  fd_ = fd;
+  fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) | O_NONBLOCK);
+  stop_ = false;
+  thread_ = std::thread(&SerialLink::pump, this);
+}
+
+void SerialLink::close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  txSpace_.notify_all();
+  rxReady_.notify_all();
+  if (thread_.joinable()) thread_.join();
+  if (fd_ >= 0) ::close(fd_);
+  if (ptySlave_ >= 0) ::close(ptySlave_);
+  fd_ = ptySlave_ = -1;
+}
+
+bool SerialLink::waitForInput(uint32_t us) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return rxReady_.wait_for(lock, std::chrono::microseconds(us),
+                           [this] { return !rx_.empty() || stop_; }) &&
+         !rx_.empty();
+}
+
+LinkStats SerialLink::stats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+uint64_t SerialLink::nowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Move bytes along the wire in both directions until stopped. Each byte
+// occupies its direction of the wire for byteNs_, starting once the wire
+// is free and the byte is ready to send, and arrives latencyUs after it
+// has been sent.
+void SerialLink::pump() {
+  const uint64_t latencyNs = (uint64_t)config_.latencyUs * 1000;
+  uint8_t buf[512];
+
+  while (true) {
+    uint64_t now = nowNs();
+
+    // Host to wire. The host's own buffering is unbounded, as a tty's is
+    // in practice, so everything it has written is taken at once.
+    ssize_t n = ::read(fd_, buf, sizeof(buf));
+    for (ssize_t i = 0; i < n; i++) {
+      uint64_t start = toDeviceFree_ > now ? toDeviceFree_ : now;
+      toDeviceFree_ = start + byteNs_;
+      toDevice_.push_back({toDeviceFree_ + latencyNs, buf[i]});
+    }
+
+    bool received = false;
+    bool drained = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stop_) break;
+
+      // Wire to device
+      while (!toDevice_.empty() && toDevice_.front().ns <= now) {
+        if (rx_.size() < config_.rxBuffer) {
+          rx_.push_back(toDevice_.front().b);
+          stats_.toDevice++;
+          received = true;
+        } else {
+          stats_.overruns++;
+        }
+        toDevice_.pop_front();
+      }
+
+      // Device to wire
+      while (!tx_.empty() && toHostFree_ <= now) {
+        uint64_t start = toHostFree_ > tx_.front().ns ? toHostFree_ : tx_.front().ns;
+        toHostFree_ = start + byteNs_;
+        toHost_.push_back({toHostFree_ + latencyNs, tx_.front().b});
+        tx_.pop_front();
+        drained = true;
+      }
+    }
+    if (received) rxReady_.notify_all();
+    if (drained) txSpace_.notify_all();
+
+    // Wire to host. Bytes the host has no room for wait on the wire.
+    size_t outLen = 0;
+    while (outLen < toHost_.size() && toHost_[outLen].ns <= now && outLen < sizeof(buf)) {
+      buf[outLen] = toHost_[outLen].b;
+      outLen++;
+    }
+    size_t done = 0;
+    while (done < outLen) {
+      ssize_t w = ::write(fd_, buf + done, outLen - done);
+      if (w < 0 && errno == EINTR) continue;
+      if (w <= 0) break;
+      done += w;
+    }
+    toHost_.erase(toHost_.begin(), toHost_.begin() + done);
+    if (done > 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stats_.toHost += done;
+    }
+
+    std::this_thread::sleep_for(std::chrono::microseconds(20));
+  }
+}
+
+//
+// Device end
+
+int SerialLink::DeviceEnd::available() {
+  std::lock_guard<std::mutex> lock(link_->mutex_);
+  return (int)link_->rx_.size();
+}
+
+int SerialLink::DeviceEnd::read() {
+  std::lock_guard<std::mutex> lock(link_->mutex_);
+  if (link_->rx_.empty()) return -1;
+  uint8_t b = link_->rx_.front();
+  link_->rx_.pop_front();
+  return b;
+}
+
+int SerialLink::DeviceEnd::peek() {
+  std::lock_guard<std::mutex> lock(link_->mutex_);
+  return link_->rx_.empty() ? -1 : link_->rx_.front();
+}
+
+size_t SerialLink::DeviceEnd::readBytes(char *buffer, size_t length) {
+  std::lock_guard<std::mutex> lock(link_->mutex_);
+  size_t n = 0;
+  while (n < length && !link_->rx_.empty()) {
+    buffer[n++] = (char)link_->rx_.front();
+    link_->rx_.pop_front();
+  }
+  return n;
+}
+
+size_t SerialLink::DeviceEnd::write(const uint8_t *buffer, size_t size) {
+  std::unique_lock<std::mutex> lock(link_->mutex_);
+  for (size_t i = 0; i < size; i++) {
+    link_->txSpace_.wait(lock, [this] {
+      return link_->tx_.size() < link_->config_.txBuffer || link_->stop_;
+    });
+    if (link_->stop_) break;
+    link_->tx_.push_back({nowNs(), buffer[i]});
+  }
+  return size;
+}
+
+int SerialLink::DeviceEnd::availableForWrite() {
+  std::lock_guard<std::mutex> lock(link_->mutex_);
+  return link_->config_.txBuffer - (int)link_->tx_.size();
+}
+
+}  // namespace sim
@@ -0,0 +1,119 @@
+#pragma once
+
+// Simulated serial link between a device running on the host and host
+// software, for end-to-end testing without a board.
+
+#include <Arduino.h>
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace sim {
+
+struct LinkConfig {
+  uint32_t baud = 115200;    // 8N1, so 10 bits per byte each way
+  uint32_t latencyUs = 0;    // one-way delay added to every byte (USB, adapter)
+  uint16_t rxBuffer = 64;    // device receive buffer; bytes arriving when full are lost
+  uint16_t txBuffer = 64;    // device transmit buffer; writes block when full
+};
+
+struct LinkStats {
+  uint64_t toDevice = 0;  // bytes delivered to the device
+  uint64_t toHost = 0;    // bytes delivered to the host
+  uint64_t overruns = 0;  // bytes lost to a full device receive buffer
+};
+
+// SerialLink models a UART link as a device sees it. Bytes cross the wire
+// one at a time at the configured baud rate and arrive latencyUs later.
+// The device end is a ::Stream with Arduino-sized buffers: input that the
+// device does not read in time is lost, and writes block once the transmit
+// buffer is full, as HardwareSerial's do.
+//
+// The host end is a file descriptor: one end of a socketpair, for a client
+// in the same process, or a pty that other programs can open.
+class SerialLink {
+ public:
+  explicit SerialLink(const LinkConfig &config);
+  ~SerialLink();
+
+  SerialLink(const SerialLink &) = delete;
+  SerialLink &operator=(const SerialLink &) = delete;
+
+  // Connect the host end to a socketpair and return the host's descriptor,
+  // which the caller owns, or -1 on error
+  int openSocket();
+
+  // Connect the host end to a new pty in raw mode and return the path of
+  // its slave device, or "" on error
+  std::string openPty();
+
+  // Stop the link; the device end then reads nothing and discards writes
+  void close();
+
+  // The device end of the link
+  ::Stream *device() { return &device_; }
+
+  // Wait up to us for input to reach the device; returns true if there is
+  // some
+  bool waitForInput(uint32_t us);
+
+  LinkStats stats();
+
+ private:
+  class DeviceEnd : public ::Stream {
+   public:
+    explicit DeviceEnd(SerialLink *link) : link_(link) {}
+
+    int available();
+    int read();
+    int peek();
+    size_t readBytes(char *buffer, size_t length);
+    size_t write(uint8_t b) { return write(&b, 1); }
+    size_t write(const uint8_t *buffer, size_t size);
+    int availableForWrite();
+
+    using ::Print::write;
+    using ::Stream::readBytes;
+
+   private:
+    SerialLink *link_;
+  };
+
+  struct Timed {
+    uint64_t ns;  // time the byte was queued, or is due to arrive
+    uint8_t b;
+  };
+
+  void start(int fd);
+  void pump();
+  static uint64_t nowNs();
+
+  LinkConfig config_;
+  uint64_t byteNs_;  // time on the wire per byte
+  DeviceEnd device_;
+
+  std::mutex mutex_;
+  std::condition_variable rxReady_;  // input reached the device
+  std::condition_variable txSpace_;  // the transmit buffer drained
+  std::deque<uint8_t> rx_;           // device receive buffer
+  std::deque<Timed> tx_;             // device transmit buffer
+  LinkStats stats_;
+
+  // Owned by the pump thread
+  std::deque<Timed> toDevice_;  // on the wire, by arrival time
+  std::deque<Timed> toHost_;
+  uint64_t toDeviceFree_ = 0;  // time each direction of the wire is next free
+  uint64_t toHostFree_ = 0;
+
+  int fd_ = -1;         // link's end of the host connection
+  int ptySlave_ = -1;   // held open so that the pty survives clients closing it
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+}  // namespace sim
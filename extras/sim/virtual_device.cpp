@@ -0,0 +1,64 @@
+// Virtual device.
+//
+// Runs the DigitalInput example sketch on the host, unmodified, behind a
+// simulated serial link exposed as a pty. Host software opens the printed
+// path as it would a board's serial port. The sketch's analog inputs are
+// driven with slow waveforms so that reports change over time.
+//
+// Usage: zap_sim_device [-b baud] [-l latency-us]
+
+#include "DigitalInput.ino"
+#include "device_runner.hpp"
+#include "serial_link.hpp"
+
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+volatile sig_atomic_t interrupted = 0;
+
+void onSignal(int) { interrupted = 1; }
+
+// A 5 s sine on pin 1 and a 2 s sawtooth on pin 2, over the full ADC range
+void driveInputs(unsigned long ms) {
+  host::setAnalogPin(1, (int)(511.5 + 511.5 * sin(ms * (2 * M_PI / 5000))));
+  host::setAnalogPin(2, (int)(ms % 2000 * 1023 / 1999));
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  sim::LinkConfig config;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "-b") == 0) {
+      config.baud = strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "-l") == 0) {
+      config.latencyUs = strtoul(argv[i + 1], nullptr, 10);
+    } else {
+      fprintf(stderr, "usage: %s [-b baud] [-l latency-us]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  sim::SerialLink link(config);
+  std::string path = link.openPty();
+  if (path.empty()) {
+    perror("openpty");
+    return 1;
+  }
+  printf("%s (%u baud, %u us latency)\n", path.c_str(), config.baud, config.latencyUs);
+  fflush(stdout);
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  sim::DeviceRunner runner(&link, setup, loop, driveInputs);
+  runner.start();
+  while (!interrupted) pause();
+  runner.stop();
+  return 0;
+}
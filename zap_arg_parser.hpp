@@ -10,29 +10,134 @@ namespace zap {
 #define TOK_HEX 5
 #define TOK_FLOAT 6
 #define TOK_BOOL 7
+#define TOK_LIST 8
+#define TOK_LIST_END 9  // ArgLexer records only
+
+// Maximum nesting of [ ] lists, including the outermost
+#define ARG_MAX_LIST_DEPTH 4
+
+// First byte of a buffer of pre-lexed argument records, as produced by
+// ArgLexer. ArgParser recognises the marker and replays the records
+// instead of lexing text.
+#define ARG_RECORDS_MARKER 0x01
+
+// Extent of a nested list within the argument buffer
+struct ArgList {
+  char *start;
+  int len;
+};
 
 struct Arg {
   int index;
   const char *key;
+  char type;      // TOK_ type of the value
+  uint8_t id;     // STR_ id of a word, or STR_INVALID_STRING
+  uint8_t keyID;  // STR_ id of the key, or STR_INVALID_STRING
   union {
     bool B;
     const char *S;
     int I;
     float F;
+    ArgList L;  // read with ArgParser::enter()
   };
 
   inline bool positional() { return key == nullptr; }
   inline bool named() { return key != nullptr; }
 };
 
+// Accumulates a decimal number digit by digit; shared by ArgParser and
+// ArgLexer so that both read numbers identically.
+class DecimalNumber {
+ public:
+  // Add a digit of the integer part
+  void digit(uint8_t d) {
+    if (mantissa_ <= MANTISSA_LIMIT) {
+      mantissa_ = mantissa_ * 10 + d;
+    } else {
+      exponent_++;  // beyond float precision; just scale
+    }
+  }
+
+  // Add a digit after the decimal point
+  void fractionDigit(uint8_t d) {
+    isFloat_ = true;
+    if (mantissa_ <= MANTISSA_LIMIT) {
+      mantissa_ = mantissa_ * 10 + d;
+      exponent_--;
+    }
+  }
+
+  // Add a digit of the exponent
+  void exponentDigit(uint8_t d) {
+    isFloat_ = true;
+    if (exp_ < 1000) exp_ = exp_ * 10 + d;
+  }
+
+  void endExponent(bool negative) { exponent_ += negative ? -exp_ : exp_; }
+
+  // Store the value in dst, returning TOK_INT, TOK_FLOAT, or TOK_ERROR if
+  // an integer does not fit in an int.
+  char finish(Arg *dst, bool negate) {
+    if (isFloat_) {
+      float f = decimalToFloat(mantissa_, exponent_);
+      dst->F = negate ? -f : f;
+      return TOK_FLOAT;
+    } else if (exponent_ != 0 || mantissa_ > (uint32_t)INT_MAX) {
+      return TOK_ERROR;
+    }
+    dst->I = negate ? -(int)mantissa_ : (int)mantissa_;
+    return TOK_INT;
+  }
+
+ private:
+  static const uint32_t MANTISSA_LIMIT = (0xFFFFFFFFUL - 9) / 10;
+
+  uint32_t mantissa_ = 0;  // significant digits
+  int exponent_ = 0;       // decimal exponent of mantissa_
+  int exp_ = 0;            // explicit exponent being read
+  bool isFloat_ = false;   // has a fractional part or exponent
+};
+
 class ArgParser {
  public:
-  ArgParser(char *args, int len) : args_(args), len_(len), rp_(0) { skipSpace(); }
+  ArgParser(char *args, int len) : args_(args), len_(len), rp_(0), records_(false) {
+    if (len_ > 0 && args_[0] == ARG_RECORDS_MARKER) {
+      records_ = true;
+      rp_ = 1;
+    } else {
+      skipSpace();
+    }
+  }
 
   bool remain() const { return rp_ < len_; }
   bool end() const { return !remain(); }
 
-  bool next(Arg *dst) { return lex(dst) != TOK_ERROR; }
+  // Returns a cursor over the items of a TOK_LIST argument. Lists are
+  // read in place: the cursor is a view of the same buffer, and this
+  // parser has already moved past the list, so it can be read lazily,
+  // partly, or not at all. Nested lists are entered in the same way, to at
+  // most ARG_MAX_LIST_DEPTH levels.
+  //
+  //   if (args.next(&arg) && arg.type == TOK_LIST) {
+  //     ArgParser items = args.enter(arg);
+  //     while (items.next(&item)) { ... }
+  //   }
+  ArgParser enter(const Arg &list) const {
+    return ArgParser(list.L.start, list.L.len, records_);
+  }
+
+  // Read the next argument, positional or named. A key is returned
+  // together with the value that follows it, so dst->key is null for
+  // positional arguments; a key with no value is an error.
+  bool next(Arg *dst) {
+    dst->key = nullptr;
+    dst->keyID = STR_INVALID_STRING;
+    char tok = lex(dst);
+    if (tok == TOK_KEY) {
+      tok = lex(dst);
+    }
+    return tok != TOK_ERROR && tok != TOK_KEY;
+  }
 
   bool scanWord(Arg *dst) {
     char tok = lex(dst);
@@ -54,8 +159,25 @@ class ArgParser {
     return tok == TOK_BOOL;
   }
 
+  bool scanList(Arg *dst) {
+    char tok = lex(dst);
+    return tok == TOK_LIST;
+  }
+
  private:
+  ArgParser(char *args, int len, bool records)
+      : args_(args), len_(len), rp_(0), records_(records) {
+    if (!records_) {
+      skipSpace();
+    }
+  }
+
   char lex(Arg *dst) {
+    dst->type = records_ ? replay(dst) : lexText(dst);
+    return dst->type;
+  }
+
+  char lexText(Arg *dst) {
     char ch = curr();
     if (isAlpha(ch)) {
       return parseWBK(dst);
@@ -64,11 +186,134 @@ class ArgParser {
     } else if (ch == '-') {
       adv();
       return parseNumber(dst, true);
+    } else if (ch == '[') {
+      return parseList(dst);
     } else {
       return TOK_ERROR;
     }
   }
 
+  // Find the extent of a list; its items are lexed only if it is entered
+  char parseList(Arg *dst) {
+    adv();
+    int start = rp_;
+    int depth = 1;
+    for (; rp_ < len_; adv()) {
+      if (args_[rp_] == '[' && ++depth > ARG_MAX_LIST_DEPTH) {
+        return TOK_ERROR;
+      } else if (args_[rp_] == ']' && --depth == 0) {
+        break;
+      }
+    }
+    if (depth != 0) {
+      return TOK_ERROR;
+    }
+    dst->L.start = &args_[start];
+    dst->L.len = rp_ - start;
+    adv();
+    skipSpace();
+    return TOK_LIST;
+  }
+
+  // Replay the next pre-lexed record. Error records are never advanced
+  // past, so as with text, every subsequent read also fails.
+  char replay(Arg *dst) {
+    if (rp_ >= len_) {
+      return TOK_ERROR;
+    }
+
+    char tok = args_[rp_];
+    char *payload = &args_[rp_ + 1];
+
+    switch (tok) {
+      case TOK_WORD:
+        dst->id = (uint8_t)payload[0];
+        dst->S = payload + 1;
+        rp_ += 3 + strlen(payload + 1);
+        break;
+      case TOK_KEY:
+        dst->keyID = (uint8_t)payload[0];
+        dst->key = payload + 1;
+        rp_ += 3 + strlen(payload + 1);
+        break;
+      case TOK_INT:
+        rp_ += 1 + readVarint(payload, &dst->I);
+        break;
+      case TOK_FLOAT:
+        memcpy(&dst->F, payload, sizeof(dst->F));
+        rp_ += 1 + sizeof(dst->F);
+        break;
+      case TOK_BOOL:
+        dst->B = *payload;
+        rp_ += 2;
+        break;
+      case TOK_LIST: {
+        int end = rp_ + 1;
+        int depth = 1;
+        while (end < len_) {
+          if (args_[end] == TOK_LIST) {
+            depth++;
+          } else if (args_[end] == TOK_LIST_END && --depth == 0) {
+            break;
+          }
+          int n = recordLength(end);
+          if (n == 0) {
+            return TOK_ERROR;
+          }
+          end += n;
+        }
+        if (depth != 0) {
+          return TOK_ERROR;
+        }
+        dst->L.start = payload;
+        dst->L.len = end - rp_ - 1;
+        rp_ = end + 1;
+        break;
+      }
+      default:
+        return TOK_ERROR;
+    }
+
+    return tok;
+  }
+
+  // Length of the record at pos, or 0 for an error record
+  int recordLength(int pos) {
+    switch (args_[pos]) {
+      case TOK_WORD:
+      case TOK_KEY:
+        return 3 + strlen(&args_[pos + 2]);
+      case TOK_INT: {
+        int n = 1;
+        while (args_[pos + n] & 0x80) n++;
+        return 1 + n;
+      }
+      case TOK_FLOAT:
+        return 1 + sizeof(float);
+      case TOK_BOOL:
+        return 2;
+      case TOK_LIST:
+      case TOK_LIST_END:
+        return 1;
+      default:
+        return 0;
+    }
+  }
+
+  // Decode a zigzag varint written by ArgLexer. Returns its length.
+  static int readVarint(const char *p, int *dst) {
+    unsigned int u = 0;
+    int n = 0;
+    uint8_t b;
+    do {
+      b = p[n];
+      u |= (unsigned int)(b & 0x7F) << (7 * n);
+      n++;
+    } while (b & 0x80);
+    *dst = (int)(u >> 1) ^ -(int)(u & 1);
+    return n;
+  }
+
   bool strCmp(const char *inputText, const char *cmpText, int len) {
     for (int i = 0; i < len; i++) {
       if (inputText[i] != cmpText[i]) {
@@ -99,10 +344,12 @@ class ArgParser {
     } else if (curr() == ':') {
       args_[rp_++] = 0;
       dst->key = text;
+      dst->keyID = strid(text, len);
       tok = TOK_KEY;
     } else {
       args_[rp_++] = 0;
       dst->S = text;
+      dst->id = strid(text, len);
       tok = TOK_WORD;
     }
 
@@ -114,6 +361,10 @@ class ArgParser {
   // Read the next number.
   // Returns the token type that was read, or TOK_ERROR on error.
   // The decoded numeric value is stored in the appropriate field of dst.
+  //
+  // Decimal numbers are read as a mantissa and decimal exponent. A number
+  // with a fractional part or an exponent ("1.5", "2e-3") is a float; any
+  // other must fit in an int.
   char parseNumber(Arg *dst, bool negate) {
     if (curr() == '0' && peek() == 'x') {
       adv();
@@ -127,26 +378,45 @@ class ArgParser {
       return TOK_INT;
     }
 
-    int ipart = lexDecInt();
-    if (ipart < 0) {
+    DecimalNumber num;
+
+    if (!isNumeric(curr())) {
       return TOK_ERROR;
     }
+    while (isNumeric(curr())) {
+      num.digit(curr() - '0');
+      adv();
+    }
 
     if (curr() == '.') {
       adv();
-      int fpart = lexDecInt();
-      if (fpart < 0) {
+      if (!isNumeric(curr())) {
         return TOK_ERROR;
       }
-      // TODO: !!!
-      dst->F = 0.0;
-      skipSpace();
-      return TOK_FLOAT;
-    } else {
-      dst->I = negate ? -ipart : ipart;
-      skipSpace();
-      return TOK_INT;
+      while (isNumeric(curr())) {
+        num.fractionDigit(curr() - '0');
+        adv();
+      }
     }
+
+    if (curr() == 'e' || curr() == 'E') {
+      adv();
+      bool negativeExponent = curr() == '-';
+      if (curr() == '-' || curr() == '+') {
+        adv();
+      }
+      if (!isNumeric(curr())) {
+        return TOK_ERROR;
+      }
+      while (isNumeric(curr())) {
+        num.exponentDigit(curr() - '0');
+        adv();
+      }
+      num.endExponent(negativeExponent);
+    }
+
+    skipSpace();
+    return num.finish(dst, negate);
   }
 
   // Read the next word (naked string).
@@ -169,19 +439,6 @@ class ArgParser {
     return &args_[start];
   }
 
-  int lexDecInt() {
-    int i = 0;
-    if (!isNumeric(curr())) {
-      return -1;
-    }
-    while (isNumeric(curr())) {
-      i *= 10;
-      i += (curr() - '0');
-      adv();
-    }
-    return i;
-  }
-
   int lexHexInt() {
     int i = 0;
     if (!isHexit(curr())) {
@@ -206,13 +463,325 @@ class ArgParser {
     }
   }
 
-  inline char curr() { return args_[rp_]; }
-  inline char peek() { return args_[rp_ + 1]; }
+  // Reads are bounded by len_ so that the parser never runs on into
+  // whatever follows the frame in the RX buffer.
+  inline char curr() { return rp_ < len_ ? args_[rp_] : 0; }
+  inline char peek() { return rp_ + 1 < len_ ? args_[rp_ + 1] : 0; }
   inline void adv() { rp_++; }
 
   char *args_;
   int len_;
   int rp_;
+  bool records_;  // args_ holds ArgLexer records rather than text
+};
+
+// ArgLexer is an incremental counterpart to ArgParser's lexer. Characters
+// are fed in one at a time as they arrive and each token is reduced to a
+// compact record as soon as it ends, so only the token currently being
+// read is ever held as text. The resulting buffer can be handed to
+// ArgParser (and hence to Stream::handleMessage()) in place of the raw
+// argument text; the token sequence it yields is identical.
+//
+// Records are not always smaller than the text they replace. An int record
+// is no longer than the int's digits and the space after them, but a word
+// record is its text plus three bytes (type, id and NUL), and a float
+// record is always five bytes.
+//
+// Record layout, following the ARG_RECORDS_MARKER byte:
+//
+//   TOK_WORD, TOK_KEY   type byte, STR_ id, characters, NUL
+//   TOK_INT             type byte, zigzag varint: 7 bits per byte, low
+//                       bits first, top bit set on all but the last
+//   TOK_FLOAT           type byte, float
+//   TOK_BOOL            type byte, 0 or 1
+//   TOK_LIST            type byte; starts a nested list
+//   TOK_LIST_END        type byte; ends a nested list
+//   TOK_ERROR           type byte; always last
+class ArgLexer {
+ public:
+  ArgLexer(char *buffer, int size) : buf_(buffer), size_(size) { reset(); }
+
+  // Begin a new argument list
+  void reset() {
+    buf_[0] = ARG_RECORDS_MARKER;
+    wp_ = 1;
+    state_ = LX_SPACE;
+    depth_ = 0;
+    overflow_ = false;
+  }
+
+  // Feed the next character
+  void feed(char ch) {
+    while (!step(ch)) {
+    }
+  }
+
+  // Signal the end of input, completing any pending token
+  void finish() {
+    step(0);
+    if (depth_ != 0 && state_ != LX_ERROR) {
+      error();  // unterminated list
+    }
+  }
+
+  // Returns true if the records did not fit in the buffer
+  bool overflowed() const { return overflow_; }
+
+  // Length of the record buffer, including the marker
+  int length() const { return wp_; }
+
+ private:
+  enum {
+    LX_SPACE,       // between tokens
+    LX_WORD,        // reading a word
+    LX_SIGN,        // read '-', expecting a number
+    LX_ZERO,        // read a leading '0'; may be a hex prefix
+    LX_HEX_START,   // read "0x", expecting a hexit
+    LX_HEX,         // reading hexits
+    LX_INT,         // reading decimal digits
+    LX_FRAC_START,  // read '.', expecting a digit
+    LX_FRAC,        // reading fractional digits
+    LX_EXP_START,   // read 'e', expecting a sign or digit
+    LX_EXP_SIGN,    // read exponent sign, expecting a digit
+    LX_EXP,         // reading exponent digits
+    LX_ERROR        // lexing failed; ignore further input
+  };
+
+  // Process ch in the current state. Returns false if ch ended the current
+  // token without being consumed, in which case it must be processed again.
+  bool step(char ch) {
+    switch (state_) {
+      case LX_SPACE:
+        if (ch == ' ' || ch == '\t' || ch == 0) {
+          // skip
+        } else if (isAlpha(ch)) {
+          tokStart_ = wp_;
+          put(TOK_WORD);
+          put(STR_INVALID_STRING);  // id, filled in by endWord()
+          put(ch);
+          state_ = LX_WORD;
+        } else if (isNumeric(ch)) {
+          negate_ = false;
+          startNumber(ch);
+        } else if (ch == '-') {
+          negate_ = true;
+          state_ = LX_SIGN;
+        } else if (ch == '[' && depth_ < ARG_MAX_LIST_DEPTH) {
+          depth_++;
+          put(TOK_LIST);
+        } else if (ch == ']' && depth_ > 0) {
+          depth_--;
+          put(TOK_LIST_END);
+        } else {
+          error();
+        }
+        return true;
+
+      case LX_WORD:
+        if (isWordChar(ch)) {
+          put(ch);
+          return true;
+        }
+        return endWord(ch);
+
+      case LX_SIGN:
+        if (isNumeric(ch)) {
+          startNumber(ch);
+        } else {
+          error();
+        }
+        return true;
+
+      case LX_ZERO:
+        if (ch == 'x') {
+          state_ = LX_HEX_START;
+          return true;
+        }
+        state_ = LX_INT;
+        return step(ch);
+
+      case LX_HEX_START:
+      case LX_HEX:
+        if (isHexit(ch)) {
+          value_ <<= 4;
+          value_ |= decodeHexit(ch);
+          state_ = LX_HEX;
+          return true;
+        } else if (state_ == LX_HEX_START) {
+          error();
+          return true;
+        }
+        emitInt();
+        return false;
+
+      case LX_INT:
+        if (isNumeric(ch)) {
+          num_.digit(ch - '0');
+          return true;
+        } else if (ch == '.') {
+          state_ = LX_FRAC_START;
+          return true;
+        } else if (ch == 'e' || ch == 'E') {
+          state_ = LX_EXP_START;
+          return true;
+        }
+        emitNumber();
+        return false;
+
+      case LX_FRAC_START:
+      case LX_FRAC:
+        if (isNumeric(ch)) {
+          num_.fractionDigit(ch - '0');
+          state_ = LX_FRAC;
+          return true;
+        } else if (state_ == LX_FRAC_START) {
+          error();
+          return true;
+        } else if (ch == 'e' || ch == 'E') {
+          state_ = LX_EXP_START;
+          return true;
+        }
+        emitNumber();
+        return false;
+
+      case LX_EXP_START:
+        if (ch == '-' || ch == '+') {
+          negativeExponent_ = ch == '-';
+          state_ = LX_EXP_SIGN;
+          return true;
+        }
+        negativeExponent_ = false;
+        state_ = LX_EXP_SIGN;
+        return step(ch);
+
+      case LX_EXP_SIGN:
+      case LX_EXP:
+        if (isNumeric(ch)) {
+          num_.exponentDigit(ch - '0');
+          state_ = LX_EXP;
+          return true;
+        } else if (state_ == LX_EXP_SIGN) {
+          error();
+          return true;
+        }
+        num_.endExponent(negativeExponent_);
+        emitNumber();
+        return false;
+
+      default:
+        return true;
+    }
+  }
+
+  void startNumber(char digit) {
+    num_ = DecimalNumber();
+    num_.digit(digit - '0');
+    value_ = 0;
+    state_ = digit == '0' ? LX_ZERO : LX_INT;
+  }
+
+  // A word ends at the first non-word character, as in ArgParser::parseWBK():
+  // a boolean leaves the character for the next token, a ':' makes the word
+  // a key, and any other character is consumed along with the word, except
+  // that a ']' still closes the enclosing list.
+  bool endWord(char ch) {
+    char *text = &buf_[tokStart_ + 2];
+    int len = wp_ - tokStart_ - 2;
+
+    bool isTrue = (len == 2 && memcmp(text, "on", 2) == 0) ||
+                  (len == 3 && memcmp(text, "yes", 3) == 0) ||
+                  (len == 4 && memcmp(text, "true", 4) == 0);
+    bool isFalse = (len == 3 && memcmp(text, "off", 3) == 0) ||
+                   (len == 2 && memcmp(text, "no", 2) == 0) ||
+                   (len == 5 && memcmp(text, "false", 5) == 0);
+
+    state_ = LX_SPACE;
+
+    if (isTrue || isFalse) {
+      wp_ = tokStart_;
+      put(TOK_BOOL);
+      put(isTrue ? 1 : 0);
+      return false;
+    }
+
+    if (ch == ':') {
+      buf_[tokStart_] = TOK_KEY;
+    }
+    buf_[tokStart_ + 1] = (char)strid(text, len);
+    put(0);
+    return ch != ']';
+  }
+
+  // Emit the current hex number
+  void emitInt() {
+    if (value_ < 0) {
+      error();
+      return;
+    }
+    putInt(negate_ ? -value_ : value_);
+    state_ = LX_SPACE;
+  }
+
+  void emitNumber() {
+    Arg arg;
+    char tok = num_.finish(&arg, negate_);
+    if (tok == TOK_FLOAT) {
+      put(TOK_FLOAT);
+      putBytes(&arg.F, sizeof(arg.F));
+    } else if (tok == TOK_INT) {
+      putInt(arg.I);
+    } else {
+      error();
+      return;
+    }
+    state_ = LX_SPACE;
+  }
+
+  // Emit an int record; zigzag coding keeps small negative values short
+  void putInt(int v) {
+    unsigned int u = ((unsigned int)v << 1) ^ (unsigned int)(v >> (sizeof(int) * 8 - 1));
+    put(TOK_INT);
+    while (u >= 0x80) {
+      put((char)(u | 0x80));
+      u >>= 7;
+    }
+    put((char)u);
+  }
+
+  void error() {
+    state_ = LX_ERROR;
+    if (wp_ < size_) {
+      buf_[wp_++] = (char)TOK_ERROR;
+    } else {
+      overflow_ = true;
+    }
+  }
+
+  void put(char ch) {
+    if (wp_ < size_) {
+      buf_[wp_++] = ch;
+    } else {
+      overflow_ = true;
+      state_ = LX_ERROR;
+    }
+  }
+
+  void putBytes(const void *src, int len) {
+    const char *p = (const char *)src;
+    while (len--) put(*p++);
+  }
+
+  char *buf_;
+  int size_;
+  int wp_;                 // write position
+  int tokStart_;           // start of the record for the current word
+  uint8_t state_;          // LX_* state
+  uint8_t depth_;          // list nesting depth
+  bool negate_;            // current number is negative
+  bool negativeExponent_;  // exponent of the current number is negative
+  bool overflow_;          // buffer overflowed
+  int value_;              // value of the current hex number
+  DecimalNumber num_;      // current decimal number
 };
 
 }  // namespace zap
@@ -0,0 +1,54 @@
+#pragma once
+
+namespace zap {
+
+// A fixed set of N bits, numbered 0..N-1, stored in the fewest bytes that
+// hold them. next() finds set bits a byte at a time, so walking a sparse
+// set visits far fewer than N positions:
+//
+//   for (uint16_t i = bits.next(0); i < N; i = bits.next(i + 1)) { ... }
+template <uint16_t N>
+class Bitset {
+ public:
+  Bitset() { clear(); }
+
+  void clear() { memset(bits_, 0, sizeof(bits_)); }
+
+  void setAll() {
+    memset(bits_, 0xFF, sizeof(bits_));
+    if (N % 8) bits_[N / 8] = (1 << (N % 8)) - 1;
+  }
+
+  void set(uint16_t i) { bits_[i >> 3] |= 1 << (i & 7); }
+  void reset(uint16_t i) { bits_[i >> 3] &= ~(1 << (i & 7)); }
+  bool test(uint16_t i) const { return bits_[i >> 3] & (1 << (i & 7)); }
+
+  bool any() const {
+    for (uint16_t i = 0; i < sizeof(bits_); i++) {
+      if (bits_[i]) return true;
+    }
+    return false;
+  }
+
+  // Returns the first set bit at or after i, or N if there is none
+  uint16_t next(uint16_t i) const {
+    while (i < N) {
+      uint8_t b = bits_[i >> 3] >> (i & 7);
+      if (b == 0) {
+        i = (i | 7) + 1;
+        continue;
+      }
+      while (!(b & 1)) {
+        b >>= 1;
+        i++;
+      }
+      return i;
+    }
+    return N;
+  }
+
+ private:
+  uint8_t bits_[N > 0 ? (N + 7) / 8 : 1];
+};
+
+};  // namespace zap
@@ -0,0 +1,63 @@
+#include "Zap.hpp"
+
+namespace zap {
+
+uint16_t crc16(uint16_t crc, uint8_t b) {
+  crc ^= (uint16_t)b << 8;
+  for (uint8_t i = 0; i < 8; i++) {
+    crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+uint16_t crc16(const uint8_t *data, size_t len) {
+  uint16_t crc = CRC16_INIT;
+  while (len--) crc = crc16(crc, *data++);
+  return crc;
+}
+
+size_t cobsEncode(const uint8_t *src, size_t len, uint8_t *dst) {
+  size_t code = 0;  // position of the current block's code byte
+  size_t wp = 1;
+  uint8_t run = 1;
+
+  for (size_t i = 0; i < len; i++) {
+    if (src[i] == 0) {
+      dst[code] = run;
+      code = wp++;
+      run = 1;
+    } else {
+      dst[wp++] = src[i];
+      if (++run == 0xFF) {
+        dst[code] = run;
+        code = wp++;
+        run = 1;
+      }
+    }
+  }
+
+  dst[code] = run;
+  return wp;
+}
+
+int cobsDecode(uint8_t *buf, size_t len) {
+  size_t rp = 0;
+  size_t wp = 0;
+
+  while (rp < len) {
+    uint8_t code = buf[rp++];
+    if (code == 0 || rp + code - 1 > len) {
+      return -1;
+    }
+    for (uint8_t i = 1; i < code; i++) {
+      buf[wp++] = buf[rp++];
+    }
+    if (code != 0xFF && rp < len) {
+      buf[wp++] = 0;
+    }
+  }
+
+  return (int)wp;
+}
+
+};  // namespace zap
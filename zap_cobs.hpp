@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace zap {
+
+// COBS (Consistent Overhead Byte Stuffing) and CRC helpers used by the
+// COBS transport. In COBS mode each frame is sent as:
+//
+//   COBS(<stream-id><frame-type-marker><binary-indicator?><body><crc>) 0x00
+//
+// i.e. the same bytes as a text frame, minus the trailing newline, with
+// binary bodies carried raw rather than hex-encoded. <crc> is the
+// big-endian CRC-16/CCITT-FALSE of everything before it.
+
+// Initial value for a CRC computed with crc16()
+#define CRC16_INIT 0xFFFF
+
+// Maximum length of a COBS block, including its code byte
+#define COBS_MAX_BLOCK 255
+
+// Update a CRC-16/CCITT-FALSE with a single byte
+uint16_t crc16(uint16_t crc, uint8_t b);
+
+// Compute the CRC-16/CCITT-FALSE of len bytes
+uint16_t crc16(const uint8_t *data, size_t len);
+
+// Returns the maximum encoded size of len bytes, excluding the delimiter
+inline size_t cobsMaxEncodedLength(size_t len) { return len + len / 254 + 1; }
+
+// COBS-encode len bytes from src into dst, which must hold at least
+// cobsMaxEncodedLength(len) bytes. The 0x00 delimiter is not written.
+// Returns the encoded length.
+size_t cobsEncode(const uint8_t *src, size_t len, uint8_t *dst);
+
+// Decode a COBS block of len bytes (excluding the delimiter) in place.
+// Returns the decoded length, or -1 if the input is malformed.
+int cobsDecode(uint8_t *buf, size_t len);
+
+};  // namespace zap
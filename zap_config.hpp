@@ -0,0 +1,226 @@
+#pragma once
+
+#include <stddef.h>
+
+namespace zap {
+
+// Types of config struct members
+#define CFG_BOOL 0
+#define CFG_UINT8 1
+#define CFG_INT8 2
+#define CFG_UINT16 3
+#define CFG_INT16 4
+#define CFG_UINT32 5
+#define CFG_INT32 6
+#define CFG_FLOAT 7
+
+// Maps a member type to its CFG_ type; other types are not supported
+template <typename M>
+struct ConfigType;
+
+template <>
+struct ConfigType<bool> {
+  static const uint8_t value = CFG_BOOL;
+};
+template <>
+struct ConfigType<uint8_t> {
+  static const uint8_t value = CFG_UINT8;
+};
+template <>
+struct ConfigType<int8_t> {
+  static const uint8_t value = CFG_INT8;
+};
+template <>
+struct ConfigType<uint16_t> {
+  static const uint8_t value = CFG_UINT16;
+};
+template <>
+struct ConfigType<int16_t> {
+  static const uint8_t value = CFG_INT16;
+};
+template <>
+struct ConfigType<uint32_t> {
+  static const uint8_t value = CFG_UINT32;
+};
+template <>
+struct ConfigType<int32_t> {
+  static const uint8_t value = CFG_INT32;
+};
+template <>
+struct ConfigType<float> {
+  static const uint8_t value = CFG_FLOAT;
+};
+
+// One key of a config schema, bound to a member of the config struct.
+// Build these with ZAP_CONFIG_FIELD() / ZAP_CONFIG_KEY() so that the type
+// and offset are taken from the struct itself. min and max must lie within
+// the range of the member's type.
+struct ConfigField {
+  const char *name;  // PROGMEM key, or null to match id
+  uint8_t id;        // STR_ id of the key when name is null
+  uint8_t type;      // CFG_ type of the member
+  uint16_t offset;   // offset of the member in the struct
+  float min;
+  float max;
+};
+
+// Bind member of struct Config to the key name, a PROGMEM string
+#define ZAP_CONFIG_FIELD(Config, member, name, min, max)                                \
+  {name, zap::STR_INVALID_STRING, zap::ConfigType<decltype(Config::member)>::value, \
+   offsetof(Config, member), min, max}
+
+// Bind member of struct Config to a key in the string table
+#define ZAP_CONFIG_KEY(Config, member, id, min, max)                                   \
+  {nullptr, id, zap::ConfigType<decltype(Config::member)>::value, offsetof(Config, member), \
+   min, max}
+
+// ConfigSchema applies named arguments directly to the members of a config
+// struct, using a table of ConfigFields held in flash:
+//
+//   struct FilterConfig {
+//     uint16_t threshold = 512;
+//     float gain = 1;
+//   };
+//
+//   const char thresholdKey[] PROGMEM = "threshold";
+//   const char gainKey[] PROGMEM = "gain";
+//
+//   const zap::ConfigField filterFields[] PROGMEM = {
+//       ZAP_CONFIG_FIELD(FilterConfig, threshold, thresholdKey, 0, 1023),
+//       ZAP_CONFIG_FIELD(FilterConfig, gain, gainKey, 0, 10)};
+//
+//   const zap::ConfigSchema filterSchema(filterFields);
+//
+// Integer members accept integer values; float members accept either.
+// Values outside [min, max] are rejected. The same table describes the
+// keys in "desc" replies.
+class ConfigSchema {
+ public:
+  constexpr ConfigSchema() : fields_(nullptr), count_(0) {}
+
+  template <size_t N>
+  constexpr ConfigSchema(const ConfigField (&fields)[N]) : fields_(fields), count_(N) {
+    static_assert(N < 256, "too many config fields");
+  }
+
+  uint8_t count() const { return count_; }
+
+  // Store arg in config if its key is in the schema. Returns 1 if the value
+  // was stored, 0 if the key is not in the schema, or -1 if the value is of
+  // the wrong type or out of range, in which case config is unchanged.
+  int set(void *config, const Arg &arg) const {
+    if (arg.key == nullptr) return 0;
+    for (uint8_t i = 0; i < count_; i++) {
+      const char *name = (const char *)pgm_read_ptr(&fields_[i].name);
+      bool match = name == nullptr
+                       ? arg.keyID != STR_INVALID_STRING &&
+                             arg.keyID == pgm_read_byte(&fields_[i].id)
+                       : strcmp_P(arg.key, name) == 0;
+      if (match) {
+        ConfigField field;
+        memcpy_P(&field, &fields_[i], sizeof(field));
+        return store((char *)config + field.offset, field, arg) ? 1 : -1;
+      }
+    }
+    return 0;
+  }
+
+  // Write the schema as the "config" desc key:
+  //
+  //   config:[threshold:[int 0 1023] gain:[float 0 10] invert:[bool]]
+  void describe(BaseProtocol *proto) const {
+    proto->writeKey(STR_CONFIG);
+    proto->out()->write('[');
+    for (uint8_t i = 0; i < count_; i++) {
+      ConfigField field;
+      memcpy_P(&field, &fields_[i], sizeof(field));
+      if (i > 0) proto->writeSpace();
+      if (field.name == nullptr) {
+        proto->writeRaw(field.id);
+      } else {
+        proto->writeRawP(field.name);
+      }
+      proto->out()->write(':');
+      proto->out()->write('[');
+      if (field.type == CFG_BOOL) {
+        proto->writeRaw(STR_BOOL);
+      } else if (field.type == CFG_FLOAT) {
+        proto->writeRawSpace(STR_FLOAT);
+        proto->write(field.min);
+        proto->writeSpace();
+        proto->write(field.max);
+      } else {
+        proto->writeRawSpace(STR_INT);
+        proto->writeInt((int32_t)field.min);
+        proto->writeSpace();
+        proto->writeInt((int32_t)field.max);
+      }
+      proto->out()->write(']');
+    }
+    proto->out()->write(']');
+  }
+
+ private:
+  static bool store(char *dst, const ConfigField &field, const Arg &arg) {
+    if (field.type == CFG_BOOL) {
+      if (arg.type != TOK_BOOL) return false;
+      *(bool *)dst = arg.B;
+      return true;
+    }
+
+    float v;
+    if (arg.type == TOK_INT || arg.type == TOK_HEX) {
+      v = arg.I;
+    } else if (arg.type == TOK_FLOAT && field.type == CFG_FLOAT) {
+      v = arg.F;
+    } else {
+      return false;
+    }
+    if (!(v >= field.min && v <= field.max)) return false;
+
+    switch (field.type) {
+      case CFG_UINT8:
+        *(uint8_t *)dst = arg.I;
+        break;
+      case CFG_INT8:
+        *(int8_t *)dst = arg.I;
+        break;
+      case CFG_UINT16:
+        *(uint16_t *)dst = arg.I;
+        break;
+      case CFG_INT16:
+        *(int16_t *)dst = arg.I;
+        break;
+      case CFG_UINT32:
+        *(uint32_t *)dst = arg.I;
+        break;
+      case CFG_INT32:
+        *(int32_t *)dst = arg.I;
+        break;
+      case CFG_FLOAT:
+        *(float *)dst = v;
+        break;
+      default:
+        return false;
+    }
+    return true;
+  }
+
+  const ConfigField *fields_;
+  uint8_t count_;
+};
+
+// Config struct of a stream that has no settings of its own
+struct NoConfig {};
+
+// True for NoConfig, whose schema is always empty
+template <typename Config>
+struct IsNoConfig {
+  static const bool value = false;
+};
+template <>
+struct IsNoConfig<NoConfig> {
+  static const bool value = true;
+};
+
+};  // namespace zap
@@ -18,15 +18,11 @@ bool isHexit(char ch) {
 }
 
 uint8_t decodeHexit(char ch) {
-  if (ch >= '0' && ch <= '9') {
-    return ch - '0';
-  } else if (ch >= 'A' && ch <= 'F') {
-    return ch - 'A' + 10;
-  } else if (ch >= 'a' && ch <= 'f') {
-    return ch - 'a' + 10;
-  } else {
-    return INVALID_HEXIT;
-  }
+#if defined(__AVR__)
+  return pgm_read_byte(&HEX_DECODE_TABLE[(uint8_t)ch]);
+#else
+  return HEX_DECODE_TABLE[(uint8_t)ch];
+#endif
 }
 
 bool isWordStartChar(char ch) { return isAlpha(ch) || ch == '_'; }
@@ -36,12 +32,78 @@ bool isWordChar(char ch) {
          ch == '?' || ch == '!' || ch == '-';
 }
 
+#if defined(__AVR__)
+
+int findLineEnd(const char *buf, int len) {
+  for (int i = 0; i < len; i++) {
+    if (buf[i] == '\r' || buf[i] == '\n') return i;
+  }
+  return -1;
+}
+
+#else
+
+// Word-at-a-time scan: a word contains a CR or LF byte iff XORing with
+// the broadcast character leaves a zero byte.
+int findLineEnd(const char *buf, int len) {
+  const uint32_t ones = 0x01010101UL;
+  const uint32_t highs = 0x80808080UL;
+  const uint32_t crs = ones * '\r';
+  const uint32_t lfs = ones * '\n';
+
+  int i = 0;
+  for (; i + 4 <= len; i += 4) {
+    uint32_t w;
+    memcpy(&w, buf + i, 4);
+    uint32_t a = w ^ crs;
+    uint32_t b = w ^ lfs;
+    if ((((a - ones) & ~a) | ((b - ones) & ~b)) & highs) break;
+  }
+  for (; i < len; i++) {
+    if (buf[i] == '\r' || buf[i] == '\n') return i;
+  }
+  return -1;
+}
+
+#endif
+
+#if ZAP_FLASH_ACCESSORS
+
 bool streq(int strTableIx, const char* str) {
   return strcmp_P(str, strptr(strTableIx)) == 0;
 }
 
 const char* strptr(int strTableIx) {
-  return (const char*)pgm_read_word(&(string_table[strTableIx]));
+  return (const char*)pgm_read_ptr(&(string_table[strTableIx]));
+}
+
+int strlength(int strTableIx) { return strlen_P(strptr(strTableIx)); }
+
+uint8_t strid(const char* str, int len) {
+  uint8_t ix = pgm_read_byte(&string_index_heads[stringHash(str, len)]);
+  while (ix != STR_INVALID_STRING) {
+    const char* entry = strptr(ix);
+    if (strncmp_P(str, entry, len) == 0 && pgm_read_byte(entry + len) == 0) {
+      return ix;
+    }
+    ix = pgm_read_byte(&string_index_next[ix]);
+  }
+  return STR_INVALID_STRING;
 }
 
+#else
+
+uint8_t strid(const char* str, int len) {
+  uint8_t ix = string_index_heads[stringHash(str, len)];
+  while (ix != STR_INVALID_STRING) {
+    if (string_table[ix].len == len && memcmp(str, string_table[ix].str, len) == 0) {
+      return ix;
+    }
+    ix = string_index_next[ix];
+  }
+  return STR_INVALID_STRING;
+}
+
+#endif
+
 };  // namespace zap
\ No newline at end of file
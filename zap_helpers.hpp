@@ -6,11 +6,22 @@ namespace zap {
 
 extern const int INVALID_HEXIT;
 
+// PROGMEM data must be read through the pgm_read_*() accessors on AVR,
+// where flash has an address space of its own, and on ESP8266, where it
+// only allows aligned 32-bit reads. Elsewhere flash is mapped into the
+// address space and constant data can be read like any other.
+#ifndef ZAP_FLASH_ACCESSORS
+#if defined(__AVR__) || defined(ESP8266)
+#define ZAP_FLASH_ACCESSORS 1
+#else
+#define ZAP_FLASH_ACCESSORS 0
+#endif
+#endif
+
 // IndifferentString represents a constant string that could be resident in
 // either ROM or RAM. Ownership concerns are out of scope.
-//
-// TODO: work out how to make this a zero-cost abstraction on platforms that
-// do not distinguish between ROM/RAM.
+#if ZAP_FLASH_ACCESSORS
+
 class IndifferentString {
  public:
   IndifferentString() : str_((const char *)nullptr), ram_(true) {}
@@ -36,6 +47,31 @@ class IndifferentString {
   bool ram_;
 };
 
+#else
+
+// A flash string is readable in place, so every string is treated as RAM
+// and isRAM() is a constant that callers' branches fold away on.
+class IndifferentString {
+ public:
+  constexpr IndifferentString() : str_(nullptr) {}
+  constexpr IndifferentString(const char *str) : str_(str) {}
+  IndifferentString(const __FlashStringHelper *str)
+      : str_(reinterpret_cast<const char *>(str)) {}
+
+  constexpr bool isRAM() const { return true; }
+  constexpr bool isROM() const { return false; }
+
+  operator const char *() const { return str_; }
+  operator const __FlashStringHelper *() const {
+    return reinterpret_cast<const __FlashStringHelper *>(str_);
+  }
+
+ private:
+  const char *str_;
+};
+
+#endif
+
 // Convert v (0 <= v <= 15) to it's ASCII hex equivalent
 char toHex(uint8_t v);
 
@@ -58,6 +94,12 @@ bool isWordStartChar(char ch);
 // Returns true if ch is a valid Zap word character
 bool isWordChar(char ch);
 
+// Returns the offset of the first '\r' or '\n' in buf[0..len), or -1 if
+// there is none.
+int findLineEnd(const char *buf, int len);
+
+#if ZAP_FLASH_ACCESSORS
+
 // Compares a string to an entry in the string table, returning
 // true if the two are equal.
 bool streq(int strTableIx, const char *str);
@@ -65,4 +107,13 @@ bool streq(int strTableIx, const char *str);
 // Return a PROGMEM pointer to an item in the string table
 const char *strptr(int strTableIx);
 
+// Return the length of an item in the string table
+int strlength(int strTableIx);
+
+#endif
+
+// Look up str[0..len) in the string table, returning its STR_ id or
+// STR_INVALID_STRING if it is not present.
+uint8_t strid(const char *str, int len);
+
 };  // namespace zap
@@ -0,0 +1,179 @@
+#include "Zap.hpp"
+
+namespace zap {
+
+// The tables only live in PROGMEM on AVR; elsewhere const data is already
+// in flash and plain reads are cheaper than the pgm_read_*() accessors.
+#if defined(__AVR__)
+#define ZAP_HEX_TABLE PROGMEM
+#else
+#define ZAP_HEX_TABLE
+#endif
+
+// Two characters per byte value
+const char HEX_ENCODE_TABLE[513] ZAP_HEX_TABLE =
+    "000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F"
+    "202122232425262728292A2B2C2D2E2F303132333435363738393A3B3C3D3E3F"
+    "404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F"
+    "606162636465666768696A6B6C6D6E6F707172737475767778797A7B7C7D7E7F"
+    "808182838485868788898A8B8C8D8E8F909192939495969798999A9B9C9D9E9F"
+    "A0A1A2A3A4A5A6A7A8A9AAABACADAEAFB0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+    "C0C1C2C3C4C5C6C7C8C9CACBCCCDCECFD0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+    "E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEFF0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+// Nibble value per character, or INVALID_HEXIT
+const uint8_t HEX_DECODE_TABLE[256] ZAP_HEX_TABLE = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+#if defined(__AVR__)
+
+void hexEncode(const uint8_t *src, size_t len, char *dst) {
+  while (len--) {
+    const char *e = &HEX_ENCODE_TABLE[*src++ * 2];
+    *dst++ = pgm_read_byte(e);
+    *dst++ = pgm_read_byte(e + 1);
+  }
+}
+
+int hexDecode(const char *src, size_t len, uint8_t *dst) {
+  if (len & 1) return -1;
+  int n = len / 2;
+  while (len) {
+    uint8_t high = pgm_read_byte(&HEX_DECODE_TABLE[(uint8_t)*src++]);
+    uint8_t low = pgm_read_byte(&HEX_DECODE_TABLE[(uint8_t)*src++]);
+    if ((high | low) & 0x80) return -1;
+    *dst++ = (high << 4) | low;
+    len -= 2;
+  }
+  return n;
+}
+
+#else
+
+#if defined(__SIZEOF_POINTER__) && __SIZEOF_POINTER__ == 8 && \
+    defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define ZAP_HEX_SWAR 1
+#endif
+
+#ifdef ZAP_HEX_SWAR
+
+static const uint64_t ONES = 0x0101010101010101ULL;
+static const uint64_t HIGHS = 0x8080808080808080ULL;
+
+// Encode 4 bytes into 8 characters
+static inline void encode4(const uint8_t *src, char *dst) {
+  uint32_t x;
+  memcpy(&x, src, 4);
+
+  // Spread each byte into its own 16-bit lane, then split the nibbles so
+  // that the high nibble comes first in memory.
+  uint64_t t = x;
+  t = (t | (t << 16)) & 0x0000FFFF0000FFFFULL;
+  t = (t | (t << 8)) & 0x00FF00FF00FF00FFULL;
+  uint64_t v = ((t >> 4) & 0x000F000F000F000FULL) | ((t & 0x000F000F000F000FULL) << 8);
+
+  // '0' + n, plus 7 more for n >= 10 to land on 'A'
+  uint64_t letters = ((v + ONES * 0x76) & HIGHS) >> 7;
+  v += ONES * '0' + letters * 7;
+  memcpy(dst, &v, 8);
+}
+
+// Decode 8 characters into 4 bytes; returns false on a non-hex character
+static inline bool decode4(const char *src, uint8_t *dst) {
+  uint64_t v;
+  memcpy(&v, src, 8);
+  if (v & HIGHS) return false;
+
+  // Per-byte range checks; no lane can carry since every byte is < 0x80
+  uint64_t digit = (v + ONES * (0x80 - '0')) & ~(v + ONES * (0x7F - '9'));
+  uint64_t lower = v | (ONES * 0x20);
+  uint64_t alpha = (lower + ONES * (0x80 - 'a')) & ~(lower + ONES * (0x7F - 'f'));
+  if (((digit | alpha) & HIGHS) != HIGHS) return false;
+
+  uint64_t n = (v & (ONES * 0x0F)) + ((alpha & HIGHS) >> 7) * 9;
+
+  // Pair up nibbles, then pack the 16-bit lanes down to bytes
+  uint64_t t = ((n & 0x000F000F000F000FULL) << 4) | ((n >> 8) & 0x000F000F000F000FULL);
+  t = (t | (t >> 8)) & 0x0000FFFF0000FFFFULL;
+  t = (t | (t >> 16)) & 0x00000000FFFFFFFFULL;
+  uint32_t x = (uint32_t)t;
+  memcpy(dst, &x, 4);
+  return true;
+}
+
+#else
+
+static inline void encode4(const uint8_t *src, char *dst) {
+  memcpy(dst, &HEX_ENCODE_TABLE[src[0] * 2], 2);
+  memcpy(dst + 2, &HEX_ENCODE_TABLE[src[1] * 2], 2);
+  memcpy(dst + 4, &HEX_ENCODE_TABLE[src[2] * 2], 2);
+  memcpy(dst + 6, &HEX_ENCODE_TABLE[src[3] * 2], 2);
+}
+
+static inline bool decode4(const char *src, uint8_t *dst) {
+  const uint8_t *s = (const uint8_t *)src;
+  uint8_t n0 = HEX_DECODE_TABLE[s[0]], n1 = HEX_DECODE_TABLE[s[1]];
+  uint8_t n2 = HEX_DECODE_TABLE[s[2]], n3 = HEX_DECODE_TABLE[s[3]];
+  uint8_t n4 = HEX_DECODE_TABLE[s[4]], n5 = HEX_DECODE_TABLE[s[5]];
+  uint8_t n6 = HEX_DECODE_TABLE[s[6]], n7 = HEX_DECODE_TABLE[s[7]];
+  if ((n0 | n1 | n2 | n3 | n4 | n5 | n6 | n7) & 0x80) return false;
+  dst[0] = (n0 << 4) | n1;
+  dst[1] = (n2 << 4) | n3;
+  dst[2] = (n4 << 4) | n5;
+  dst[3] = (n6 << 4) | n7;
+  return true;
+}
+
+#endif
+
+void hexEncode(const uint8_t *src, size_t len, char *dst) {
+  for (; len >= 4; len -= 4, src += 4, dst += 8) {
+    encode4(src, dst);
+  }
+  while (len--) {
+    memcpy(dst, &HEX_ENCODE_TABLE[*src++ * 2], 2);
+    dst += 2;
+  }
+}
+
+int hexDecode(const char *src, size_t len, uint8_t *dst) {
+  if (len & 1) return -1;
+  int n = len / 2;
+  for (; len >= 8; len -= 8, src += 8, dst += 4) {
+    if (!decode4(src, dst)) return -1;
+  }
+  while (len) {
+    uint8_t high = HEX_DECODE_TABLE[(uint8_t)*src++];
+    uint8_t low = HEX_DECODE_TABLE[(uint8_t)*src++];
+    if ((high | low) & 0x80) return -1;
+    *dst++ = (high << 4) | low;
+    len -= 2;
+  }
+  return n;
+}
+
+#endif
+
+};  // namespace zap
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace zap {
+
+// Hex codec for binary frame bodies.
+//
+// Both directions are table-driven: a 256-entry table maps each byte to
+// its two-character encoding, and another maps each character to its
+// nibble value (or INVALID_HEXIT). AVR builds keep the tables in flash
+// and work a byte at a time; 32-bit targets process four bytes per
+// iteration, and 64-bit little-endian hosts use a SWAR path that handles
+// eight hex characters per word.
+
+// Lookup tables; in PROGMEM on AVR
+extern const char HEX_ENCODE_TABLE[513];
+extern const uint8_t HEX_DECODE_TABLE[256];
+
+// Hex-encode len bytes from src into dst, which must hold 2 * len
+// characters. Output is uppercase and not NUL-terminated.
+void hexEncode(const uint8_t *src, size_t len, char *dst);
+
+// Decode len hex characters from src into dst. dst may alias src (decoding
+// in place), or start before it. Returns the number of bytes written, or
+// -1 if len is odd or src contains a non-hex character.
+int hexDecode(const char *src, size_t len, uint8_t *dst);
+
+};  // namespace zap
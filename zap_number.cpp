@@ -0,0 +1,152 @@
+#include "Zap.hpp"
+
+#include <math.h>
+
+namespace zap {
+
+#if defined(__AVR__)
+#define ZAP_NUMBER_TABLE PROGMEM
+#define ZAP_READ_POW10F(i) pgm_read_float(&POW10F[i])
+#define ZAP_READ_POW10(i) pgm_read_dword(&POW10[i])
+#else
+#define ZAP_NUMBER_TABLE
+#define ZAP_READ_POW10F(i) POW10F[i]
+#define ZAP_READ_POW10(i) POW10[i]
+#endif
+
+namespace {
+
+// Powers of ten that are exact in a float
+const float POW10F[11] ZAP_NUMBER_TABLE = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f,
+                                           1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+const uint32_t POW10[10] ZAP_NUMBER_TABLE = {
+    1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL, 10000000UL, 100000000UL,
+    1000000000UL};
+
+inline void putPair(uint8_t v, char *dst) {
+#if defined(__AVR__)
+  dst[0] = pgm_read_byte(&DIGIT_PAIRS[v * 2]);
+  dst[1] = pgm_read_byte(&DIGIT_PAIRS[v * 2 + 1]);
+#else
+  memcpy(dst, &DIGIT_PAIRS[v * 2], 2);
+#endif
+}
+
+template <typename T>
+char *formatDecimal(T v, char *end) {
+  while (v >= 100) {
+    T q = v / 100;
+    end -= 2;
+    putPair(v - q * 100, end);
+    v = q;
+  }
+  if (v >= 10) {
+    end -= 2;
+    putPair(v, end);
+  } else {
+    *--end = '0' + v;
+  }
+  return end;
+}
+
+}  // namespace
+
+const char DIGIT_PAIRS[201] ZAP_NUMBER_TABLE =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+char *formatUInt(uint16_t v, char *end) { return formatDecimal(v, end); }
+
+char *formatUInt(uint32_t v, char *end) {
+  // Drop to 16-bit arithmetic as soon as the value fits
+  while (v > 0xFFFF) {
+    uint32_t q = v / 100;
+    end -= 2;
+    putPair(v - q * 100, end);
+    v = q;
+  }
+  return formatDecimal((uint16_t)v, end);
+}
+
+char *formatHex(uint32_t v, char *end) {
+  do {
+    end -= 2;
+#if defined(__AVR__)
+    end[0] = pgm_read_byte(&HEX_ENCODE_TABLE[(v & 0xFF) * 2]);
+    end[1] = pgm_read_byte(&HEX_ENCODE_TABLE[(v & 0xFF) * 2 + 1]);
+#else
+    memcpy(end, &HEX_ENCODE_TABLE[(v & 0xFF) * 2], 2);
+#endif
+    v >>= 8;
+  } while (v);
+  return end[0] == '0' ? end + 1 : end;  // at most one leading zero
+}
+
+float decimalToFloat(uint32_t mantissa, int exponent) {
+  float v = (float)mantissa;
+  if (mantissa == 0) return v;
+  while (exponent > 10) {
+    v *= 1e10f;
+    exponent -= 10;
+  }
+  while (exponent < -10) {
+    v /= 1e10f;
+    exponent += 10;
+  }
+  if (exponent > 0) {
+    v *= ZAP_READ_POW10F(exponent);
+  } else if (exponent < 0) {
+    v /= ZAP_READ_POW10F(-exponent);
+  }
+  return v;
+}
+
+int formatFloat(float v, uint8_t decimals, char *dst) {
+  if (isnan(v)) {
+    memcpy(dst, "nan", 3);
+    return 3;
+  } else if (isinf(v)) {
+    memcpy(dst, "inf", 3);
+    return 3;
+  } else if (v > 4294967040.0f || v < -4294967040.0f) {
+    memcpy(dst, "ovf", 3);
+    return 3;
+  }
+
+  char *p = dst;
+  if (v < 0) {
+    *p++ = '-';
+    v = -v;
+  }
+  if (decimals > 9) decimals = 9;
+
+  // v - ipart is exact, so the only rounding is in scaling the fraction
+  uint32_t ipart = (uint32_t)v;
+  uint32_t scale = ZAP_READ_POW10(decimals);
+  uint32_t fpart = (uint32_t)((v - (float)ipart) * scale + 0.5f);
+  if (fpart >= scale) {
+    ipart++;
+    fpart -= scale;
+  }
+
+  char digits[10];
+  char *end = digits + sizeof(digits);
+  char *start = formatUInt(ipart, end);
+  memcpy(p, start, end - start);
+  p += end - start;
+
+  if (decimals > 0) {
+    // Zero-padded to the full width
+    *p++ = '.';
+    char *dp = p + decimals;
+    char *fstart = formatUInt(fpart, dp);
+    memset(p, '0', fstart - p);
+    p = dp;
+  }
+
+  return p - dst;
+}
+
+};  // namespace zap
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace zap {
+
+// Number conversion without strtod()/printf(): floats are parsed from a
+// decimal mantissa and exponent collected by the lexer, and integers and
+// floats are formatted with integer arithmetic, two decimal digits at a
+// time from a lookup table.
+//
+// The integer formatters write backwards from end and return a pointer to
+// the first character, so that the result can be sent with one write.
+// 16-bit overloads keep to 16-bit division, which matters on AVR.
+
+// "00" to "99"; in PROGMEM on AVR
+extern const char DIGIT_PAIRS[201];
+
+// Longest output of the integer formatters: sign and 10 digits
+const int INT_FORMAT_MAX = 11;
+
+char *formatUInt(uint16_t v, char *end);
+char *formatUInt(uint32_t v, char *end);
+
+// Uppercase hex without leading zeros, as Print::print(v, HEX)
+char *formatHex(uint32_t v, char *end);
+
+// Longest output of formatFloat(): sign, 10 integer digits, point and 9
+// decimal places
+const int FLOAT_FORMAT_MAX = 21;
+
+// Returns mantissa * 10^exponent. A single rounding step is involved when
+// mantissa < 2^24 and |exponent| <= 10, so such values (e.g. anything
+// written with up to 7 significant digits) are correctly rounded.
+float decimalToFloat(uint32_t mantissa, int exponent);
+
+// Format v with the given number of decimal places (at most 9) into dst,
+// which must hold FLOAT_FORMAT_MAX characters. As with Arduino's
+// Print::print(double), values beyond the range of uint32_t are written as
+// "ovf". Output is not NUL-terminated; returns the number of characters
+// written.
+int formatFloat(float v, uint8_t decimals, char *dst);
+
+};  // namespace zap
@@ -2,31 +2,161 @@
 
 namespace zap {
 
+// Longest request tag, in hexits
+#define TAG_MAX_LENGTH 4
+
 class BaseProtocol {
  public:
-  BaseProtocol(::Stream *port) : port_(port) {}
+  BaseProtocol(::Stream *port) : BaseProtocol(port, nullptr, 0) {}
 
-  inline ::Stream *port() const { return port_; }
+  // Construct with a TX frame buffer of txBufferSize bytes. Frames are
+  // assembled in the buffer and handed to the port with a single
+  // write(const uint8_t*, size_t) call when the frame ends.
+  //
+  // Overflow policy: if a frame outgrows the buffer, the buffered portion
+  // is written to the port and assembly continues from the start of the
+  // buffer. The frame is therefore always sent intact, just in more than
+  // one write.
+  BaseProtocol(::Stream *port, uint8_t *txBuffer, uint16_t txBufferSize)
+      : port_(port), out_(this), txBuffer_(txBuffer), txSize_(txBufferSize) {}
+
+  // Returns the underlying port. Any buffered frame data is flushed first
+  // so that bytes written directly to the port stay in order; prefer out()
+  // when writing frame content.
+  inline ::Stream *port() {
+    flushTx();
+    return port_;
+  }
+
+  // Returns a Print that writes into the current frame.
+  inline ::Print *out() { return &out_; }
+
+  // Write any buffered frame data to the port. In COBS mode a frame can
+  // only be written a block at a time, so this does nothing.
+  void flushTx() {
+    if (!cobs_ && txLen_ > 0) {
+      portWrite(txBuffer_, txLen_);
+      txLen_ = 0;
+    }
+  }
 
   //
   // Frame wrappers
 
-  // Start a reply message on the specified stream ID
+  // Start a reply message on the specified stream ID. The reply carries
+  // the tag of the request being handled, if it had one.
   void startMessage(uint8_t streamID) {
-    port_->write(toHex(streamID));
-    port_->write('>');
+    writeStreamID(streamID);
+    put('>');
+    if (tagLen_ > 0) {
+      put('@');
+      put((const uint8_t *)tag_, tagLen_);
+      put(' ');
+    }
   }
 
   // Start a notification on the specified stream ID
   void startNotification(uint8_t streamID) {
-    port_->write(toHex(streamID));
-    port_->write('!');
+    writeStreamID(streamID);
+    put('!');
   }
 
-  // End the current frame with a newline
+  // End the current frame with a newline, flushing the TX buffer. In COBS
+  // mode the frame's CRC and delimiter are written instead.
   void endFrame() {
-    port_->write('\r');
-    port_->write('\n');
+    if (cobs_) {
+      uint16_t crc = txCRC_;
+      cobsPut(crc >> 8);
+      cobsPut(crc & 0xFF);
+      endCOBSFrame();
+      return;
+    }
+    put('\r');
+    put('\n');
+    flushTx();
+  }
+
+  // Returns true if the COBS transport is active
+  inline bool cobs() const { return cobs_; }
+
+  //
+  // Stream IDs
+  //
+  // Short IDs, the default, are a single hexit, 0-F, in frame headers and
+  // in arguments alike. Once the host selects extended IDs with the "ids"
+  // command every stream ID is a decimal integer, 0-255, so that a device
+  // can have more than 15 streams; IDs 0-9 are written the same either way.
+
+  inline bool extendedIDs() const { return extendedIDs_; }
+
+  // Write a stream ID in the current encoding. IDs above 15 have no short
+  // form and are always written in decimal.
+  void writeStreamID(uint8_t streamID) {
+    if (extendedIDs_ || streamID > 15) {
+      writeUInt(streamID);
+    } else {
+      put(toHex(streamID));
+    }
+  }
+
+  // Read a positional stream ID argument into arg->I. Integers are taken
+  // as they are; with short IDs a hexit word ("A") is accepted as well.
+  bool scanStreamID(ArgParser *p, Arg *arg) {
+    if (!p->next(arg) || arg->named()) return false;
+    if (arg->type == TOK_INT || arg->type == TOK_HEX) return true;
+    if (extendedIDs_ || arg->type != TOK_WORD || arg->S[0] == 0 || arg->S[1] != 0) {
+      return false;
+    }
+    uint8_t v = decodeHexit(arg->S[0]);
+    if (v == INVALID_HEXIT) return false;
+    arg->I = v;
+    return true;
+  }
+
+  //
+  // Request tags
+  //
+  // A request may carry a tag of 1-4 hexits straight after its frame type
+  // marker, "1<@2F read", which the reply echoes, "1>@2F read 512". A host
+  // can then have many requests in flight and match each reply to its
+  // request whatever order they come back in. A space after the tag is
+  // part of it; a binary request is written "1<@2F #0A0B".
+
+  // Read a tag at the start of body[0..len), making it the tag of the reply
+  // to this request. Returns the number of bytes taken, or 0 if body does
+  // not start with a well-formed tag, in which case it is left as it is.
+  int readTag(const char *body, int len) {
+    if (len < 2 || body[0] != '@') return 0;
+    int n = 1;
+    while (n < len && n <= TAG_MAX_LENGTH && decodeHexit(body[n]) != INVALID_HEXIT) n++;
+    if (n == 1 || (n < len && body[n] != ' ' && body[n] != '#')) return 0;
+    setTag(body + 1, n - 1);
+    return n < len && body[n] == ' ' ? n + 1 : n;
+  }
+
+  void setTag(const char *tag, uint8_t len) {
+    memcpy(tag_, tag, len);
+    tagLen_ = len;
+  }
+
+  // Forget the tag once the reply to the tagged request has been sent
+  void clearTag() { tagLen_ = 0; }
+
+  //
+  // Backpressure
+  //
+  // Replies are always sent, blocking if the port is full. Notifications
+  // give way to them: with a headroom set, a notification should only be
+  // started while the port can take at least that many bytes without
+  // blocking, per availableForWrite(), leaving the rest of its buffer for
+  // replies. 0 (the default) disables the check, for ports that do not
+  // implement availableForWrite().
+
+  void setNotifyHeadroom(uint8_t bytes) { headroom_ = bytes; }
+
+  // Returns true if a notification can be written without blocking
+  bool canNotify() {
+    return headroom_ == 0 || port_->availableForWrite() - (int)txLen_ >= headroom_;
   }
 
   //
@@ -37,40 +167,100 @@ class BaseProtocol {
   // to ensure the integrity of the underlying protocol stream.
 
   // Write a single space character
-  void writeSpace() { port_->write(' '); }
+  void writeSpace() { put(' '); }
+
+  // Write an integer, encoded as decimal. The overload is picked by size:
+  // where int32_t is long (newlib), int matches no writeInt() exactly.
+  void write(int x) {
+    if (sizeof(int) <= 2) {
+      writeInt((int16_t)x);
+    } else {
+      writeInt((int32_t)x);
+    }
+  }
+
+  // Write an unsigned integer, encoded as decimal
+  void writeUInt(uint8_t x) { writeUInt((uint16_t)x); }
+  void writeUInt(uint16_t x) {
+    char buf[INT_FORMAT_MAX];
+    putFrom(formatUInt(x, buf + sizeof(buf)), buf + sizeof(buf));
+  }
+  void writeUInt(uint32_t x) {
+    char buf[INT_FORMAT_MAX];
+    putFrom(formatUInt(x, buf + sizeof(buf)), buf + sizeof(buf));
+  }
+
+  // Write a signed integer, encoded as decimal
+  void writeInt(int8_t x) { writeInt((int16_t)x); }
+  void writeInt(int16_t x) {
+    char buf[INT_FORMAT_MAX];
+    char *p = formatUInt((uint16_t)(x < 0 ? 0 - (uint16_t)x : x), buf + sizeof(buf));
+    if (x < 0) *--p = '-';
+    putFrom(p, buf + sizeof(buf));
+  }
+  void writeInt(int32_t x) {
+    char buf[INT_FORMAT_MAX];
+    char *p = formatUInt((uint32_t)(x < 0 ? 0 - (uint32_t)x : x), buf + sizeof(buf));
+    if (x < 0) *--p = '-';
+    putFrom(p, buf + sizeof(buf));
+  }
 
-  // Write an integer, encoded as decimal
-  void write(int x) { port_->print(x, DEC); }
+  // Write an unsigned integer, encoded as uppercase hex without leading zeros
+  void writeHex(uint32_t x) {
+    char buf[8];
+    putFrom(formatHex(x, buf + sizeof(buf)), buf + sizeof(buf));
+  }
+
+  // Write an integer of any type with the narrowest of the above that
+  // holds it
+  template <typename T>
+  void writeInteger(T x) {
+    if ((T)-1 < (T)0) {
+      if (sizeof(T) <= 2) {
+        writeInt((int16_t)x);
+      } else {
+        writeInt((int32_t)x);
+      }
+    } else if (sizeof(T) <= 2) {
+      writeUInt((uint16_t)x);
+    } else {
+      writeUInt((uint32_t)x);
+    }
+  }
 
   // Write a floating point value, encoded to the specified number of decimal
   // places
-  void write(float x, int decimalPlaces = 4) { port_->print(x, decimalPlaces); }
+  void write(float x, int decimalPlaces = 4) {
+    char buf[FLOAT_FORMAT_MAX];
+    put((const uint8_t *)buf, formatFloat(x, decimalPlaces, buf));
+  }
 
   // Write a boolean value, encoded as "true" or "false"
   void write(bool x) { writeRaw(x ? STR_TRUE : STR_FALSE); }
 
   void writeQuotedString(const char *msg) {
     // TODO: support escaping
-    port_->write('"');
+    put('"');
     writeRaw(msg);
-    port_->write('"');
+    put('"');
   }
 
   void writeQuotedString(const __FlashStringHelper *msg) {
     // TODO: support escaping
-    port_->write('"');
+    put('"');
     writeRaw(msg);
-    port_->write('"');
+    put('"');
   }
 
   void writeQuotedString(const IndifferentString msg) {
     // TODO: support escaping
-    port_->write('"');
+    put('"');
     writeRaw(msg);
-    port_->write('"');
+    put('"');
   }
 
   void writeError(int id) {
+    if (stats_) stats_->countError(id);
     writeKey(STR_ERROR);
     writeRaw(id);
   }
@@ -116,7 +306,7 @@ class BaseProtocol {
 
   void writeKey(int stringTableEntryIndex) {
     writeRaw(stringTableEntryIndex);
-    port_->write(':');
+    put(':');
   }
 
   void writeOK() { writeRaw(STR_OK); }
@@ -126,7 +316,7 @@ class BaseProtocol {
     if (wait > 0) {
       writeSpace();
       writeKey(STR_WAIT);
-      port_->print(wait, DEC);
+      write(wait);
     }
   }
 
@@ -135,12 +325,34 @@ class BaseProtocol {
     writeBinary(data, len);
   }
 
-  void writeBinaryMarker() { port_->print('#'); }
+  void writeBinaryMarker() { put('#'); }
 
+  // Write binary data; hex-encoded, or raw in COBS mode. When buffering,
+  // data is encoded straight into the TX buffer.
   void writeBinary(char *data, int len) {
-    while (len--) {
-      port_->write(toHex(*data >> 4));
-      port_->write(toHex((*data++) & 0xF));
+    const uint8_t *src = (const uint8_t *)data;
+
+    if (cobs_) {
+      put(src, len);
+      return;
+    }
+
+    while (len > 0) {
+      int n;
+      if (txSize_ >= 2) {
+        if (txSize_ - txLen_ < 2) flushTx();
+        n = (txSize_ - txLen_) / 2;
+        if (n > len) n = len;
+        hexEncode(src, n, (char *)txBuffer_ + txLen_);
+        txLen_ += n * 2;
+      } else {
+        char chunk[32];
+        n = len < 16 ? len : 16;
+        hexEncode(src, n, chunk);
+        portWrite((const uint8_t *)chunk, n * 2);
+      }
+      src += n;
+      len -= n;
     }
   }
 
@@ -156,22 +368,34 @@ class BaseProtocol {
   }
 
   // Write a string from the string table
-  void writeRaw(int strTableIx) { writeRawP(strptr(strTableIx)); }
-  void writeRaw(const char *message) { port_->print(message); }
+  void writeRaw(int strTableIx) {
+#if ZAP_FLASH_ACCESSORS
+    writeRawP(strptr(strTableIx));
+#else
+    put((const uint8_t *)strptr(strTableIx), strlength(strTableIx));
+#endif
+  }
+
+  void writeRaw(const char *message) { put((const uint8_t *)message, strlen(message)); }
   void writeRaw(const __FlashStringHelper *str) { writeRawP((const char *)str); }
 
   // Write a string from the string table, followed by a space
   void writeRawSpace(int strTableIx) {
-    writeRawP(strptr(strTableIx));
-    port_->write(' ');
+    writeRaw(strTableIx);
+    put(' ');
   }
 
+  // Write a PROGMEM string
   void writeRawP(const char *str) {
+#if ZAP_FLASH_ACCESSORS
     for (int i = 0;; i++) {
       const char b = pgm_read_byte_near(str + i);
       if (b == 0) break;
-      port_->write(b);
+      put(b);
     }
+#else
+    writeRaw(str);
+#endif
   }
 
   //
@@ -202,14 +426,250 @@ class BaseProtocol {
   }
 
  protected:
+  // Switch transport; returns false if COBS was requested but the TX
+  // buffer cannot hold a complete COBS block.
+  bool setCOBS(bool enabled) {
+    if (enabled && txSize_ < COBS_MAX_BLOCK) {
+      return false;
+    }
+    flushTx();
+    cobs_ = enabled;
+    txLen_ = 0;
+    txCRC_ = CRC16_INIT;
+    return true;
+  }
+
+  void setExtendedIDs(bool enabled) { extendedIDs_ = enabled; }
+
+  // Decode the stream ID at the start of a frame of len bytes into id.
+  // Returns the length of the ID, or 0 if the frame does not start with a
+  // valid ID followed by a frame type marker.
+  int decodeStreamID(const char *frame, int len, uint8_t *id) const {
+    if (!extendedIDs_) {
+      *id = decodeHexit(frame[0]);
+      return len >= 2 && *id != INVALID_HEXIT ? 1 : 0;
+    }
+    uint16_t v = 0;
+    int n = 0;
+    while (n < len && isNumeric(frame[n])) {
+      v = v * 10 + frame[n++] - '0';
+      if (v > 0xFF) return 0;
+    }
+    if (n == 0 || n == len) return 0;
+    *id = v;
+    return n;
+  }
+
+  // Append a byte to the current frame
+  void put(uint8_t b) {
+    if (cobs_) {
+      txCRC_ = crc16(txCRC_, b);
+      cobsPut(b);
+      return;
+    }
+    if (txSize_ == 0) {
+      portWrite(b);
+      return;
+    }
+    if (txLen_ == txSize_) flushTx();
+    txBuffer_[txLen_++] = b;
+  }
+
+  // Append the characters in [start, end) to the current frame
+  void putFrom(const char *start, const char *end) {
+    put((const uint8_t *)start, end - start);
+  }
+
+  // Append len bytes to the current frame
+  void put(const uint8_t *data, size_t len) {
+    if (cobs_) {
+      while (len--) put(*data++);
+      return;
+    }
+    if (txSize_ == 0) {
+      portWrite(data, len);
+      return;
+    }
+    while (len > 0) {
+      if (txLen_ == txSize_) flushTx();
+      size_t n = txSize_ - txLen_;
+      if (n > len) n = len;
+      memcpy(txBuffer_ + txLen_, data, n);
+      txLen_ += n;
+      data += n;
+      len -= n;
+    }
+  }
+
   ::Stream *port_;
+  ProtocolStats *stats_ = nullptr;  // counters, if enabled
+
+ private:
+  // All output reaches the port through these, so that it can be counted
+  void portWrite(uint8_t b) {
+    if (stats_) stats_->txBytes++;
+    port_->write(b);
+  }
+
+  void portWrite(const uint8_t *data, size_t len) {
+    if (stats_) stats_->txBytes += len;
+    port_->write(data, len);
+  }
+
+  // COBS-encode a byte into the TX buffer, which holds the current block
+  // with its code byte at offset 0. Blocks are written out as they
+  // complete.
+  void cobsPut(uint8_t b) {
+    if (txLen_ == 0) txLen_ = 1;
+    if (b == 0) {
+      txBuffer_[0] = txLen_;
+      portWrite(txBuffer_, txLen_);
+      txLen_ = 1;
+      return;
+    }
+    txBuffer_[txLen_++] = b;
+    if (txLen_ == COBS_MAX_BLOCK) {
+      txBuffer_[0] = 0xFF;
+      portWrite(txBuffer_, txLen_);
+      txLen_ = 1;
+    }
+  }
+
+  // Write the final COBS block and frame delimiter
+  void endCOBSFrame() {
+    if (txLen_ == 0) txLen_ = 1;
+    txBuffer_[0] = txLen_;
+    if (txLen_ < txSize_) {
+      txBuffer_[txLen_++] = 0;
+      portWrite(txBuffer_, txLen_);
+    } else {
+      portWrite(txBuffer_, txLen_);
+      portWrite(0);
+    }
+    txLen_ = 0;
+    txCRC_ = CRC16_INIT;
+  }
+
+  // Adapts the frame writer to the Print interface so that print()
+  // formatting lands in the frame buffer.
+  class FramePrint : public ::Print {
+   public:
+    FramePrint(BaseProtocol *p) : p_(p) {}
+    size_t write(uint8_t b) {
+      p_->put(b);
+      return 1;
+    }
+    size_t write(const uint8_t *data, size_t len) {
+      p_->put(data, len);
+      return len;
+    }
+    using ::Print::write;
+
+   private:
+    BaseProtocol *p_;
+  };
+
+  FramePrint out_;
+
+  // TX frame buffer (optional)
+  uint8_t *txBuffer_;  // Buffer, or nullptr if unbuffered
+  uint16_t txSize_;    // Buffer capacity
+  uint16_t txLen_ = 0;  // Bytes pending
+
+  // COBS transport
+  bool cobs_ = false;            // COBS transport active
+  uint16_t txCRC_ = CRC16_INIT;  // CRC of the frame being written
+
+  bool extendedIDs_ = false;  // stream IDs are decimal rather than one hexit
+
+  char tag_[TAG_MAX_LENGTH];  // tag of the request being handled
+  uint8_t tagLen_ = 0;     // length of tag_, or 0 if the request has none
+
+  uint8_t headroom_ = 0;  // port space required to start a notification
+};
+
+// Stream is the interface Protocol dispatches each stream's frames to; the
+// stream classes in zap_stream.hpp implement it.
+class Stream {
+ public:
+  virtual void describe() = 0;
+
+  // Handle an incoming message.
+  //
+  // Before invocation, the caller will start a reply frame by writing
+  // "{$streamID}>" to the serial port. After invocation, the frame
+  // is terminated with a newline.
+  //
+  // handleMessage() uses the return value to control what additional
+  // reply is written by the caller.
+  //
+  // Return values:
+  //
+  // 0   - operation succeeded, caller will write "ok" response
+  // >0  - error; return value is assumed to be index into string table
+  //       representing the error code
+  // -1  - handleMessage() has written a response; call should take no
+  //       further action (save for ending the frame with a newline).
+  //
+  // Text frames should be read with ArgParser (e.g. via ZAP_PARSE_ARGS)
+  // rather than inspected directly: when the protocol lexes incrementally,
+  // data holds argument records instead of the raw text.
+  //
+  virtual int handleMessage(uint8_t frameType, char *data, int len) = 0;
+
+  // Returns true if this stream is capable of emitting periodic reports
+  virtual bool canReport() { return false; }
+
+  // Returns true if this stream should send a report right now.
+  // This method can be overridden, for example, to mute reports
+  // if the sensor is disabled, or to only send reports if the
+  // underlying value has changed.
+  virtual bool shouldReport() { return true; }
+
+  virtual void report() {}
+
+  // Write the body of a periodic report. By default this is report();
+  // streams whose periodic reports differ from their "read" reply
+  // override it.
+  virtual void writeReport() { report(); }
+
+  // Returns true if the body writeReport() is about to write holds only
+  // the values that changed since the last report, in which case the
+  // report is marked "report~" rather than "report".
+  virtual bool deltaReport() { return false; }
+
+  void setProtocol(BaseProtocol *p, uint8_t id) {
+    proto = p;
+    streamID = id;
+  }
+
+ protected:
+  BaseProtocol *proto;
+  uint8_t streamID;
 };
 
-template <uint8_t MaxUserStreamCount = 14, uint8_t RXBufferSize = 64>
+// Template arguments:
+//   MaxUserStreamCount - number of slots to reserve for user streams
+//   RXBufferSize       - command decode buffer size
+//   TXBufferSize       - frame assembly buffer size; 0 disables TX buffering
+//                        and every byte goes straight to the port
+//   IncrementalLexing  - lex text frames as they arrive (see ArgLexer); the
+//                        RX buffer then holds argument records rather than
+//                        raw text. Records are not always smaller than the
+//                        text, and a frame whose records do not fit gets a
+//                        too-long error
+//   Stats              - keep the counters reported by the "stats" command
+//                        (see ProtocolStats); when false they are compiled
+//                        out
+template <uint8_t MaxUserStreamCount = 14, uint8_t RXBufferSize = 64,
+          uint16_t TXBufferSize = 0, bool IncrementalLexing = false, bool Stats = false>
 class Protocol : public BaseProtocol {
  public:
   Protocol(::Stream *port, const IndifferentString deviceInfo)
-      : BaseProtocol(port), deviceInfo_(deviceInfo) {}
+      : BaseProtocol(port, TXBufferSize > 0 ? txBuffer_ : nullptr, TXBufferSize),
+        deviceInfo_(deviceInfo) {
+    stats_ = statsStore_.get();
+  }
 
   Protocol(::Stream *port, const char *deviceInfo)
       : Protocol(port, IndifferentString(deviceInfo)) {}
@@ -228,90 +688,413 @@ class Protocol : public BaseProtocol {
     streams_[id - 1] = handler;
   }
 
+  // The report schedule; slot i is stream i + 1. Exposes each stream's
+  // worst report lateness and skipped periods.
+  DeadlineScheduler<MaxUserStreamCount> &reportSchedule() { return reports_; }
+
+  // Protocol counters, or null if Stats is false
+  ProtocolStats *stats() { return Stats ? stats_ : nullptr; }
+
   //
   // Main Protocol Handler
 
   void tick() {
-    // Serial read/dispatch
+    uint32_t tickStart = Stats ? micros() : 0;
 
-    while (port_->available()) {
-      uint8_t ch = port_->read();
-      switch (rxState_) {
-        case 0:
-          if (ch == '\r') {
-            dispatch();
-            rxWp_ = 0;
-            rxState_ = 1;
-          } else if (ch == '\n') {
-            dispatch();
-            rxWp_ = 0;
-          } else {
-            rxBuffer_[rxWp_++] = ch;
-          }
-          break;
-        case 1:
-          if (ch != '\n') {
-            rxBuffer_[rxWp_++] = ch;
-          }
-          rxState_ = 0;
+    // Serial read/dispatch
+    //
+    // Input is drained in bulk into the free tail of the RX buffer, which
+    // holds at most one partial frame at its start. Each chunk is scanned
+    // for frame terminators and every complete frame in it is dispatched
+    // in place; any trailing partial frame is then moved back to the start
+    // of the buffer.
+
+    // COBS frames are always received in bulk.
+
+    int avail;
+    while (IncrementalLexing && !cobs() && (avail = port_->available()) > 0) {
+      // No larger than the RX buffer, which takes the rest of a chunk if
+      // the transport switches
+      char chunk[RXBufferSize < 16 ? RXBufferSize : 16];
+      int n = port_->readBytes(chunk, avail < (int)sizeof(chunk) ? avail : sizeof(chunk));
+      if (n <= 0) break;
+      if (Stats) stats_->rxBytes += n;
+      for (int i = 0; i < n; i++) {
+        if (cobs()) {
+          // Transport switched mid-chunk; hand the rest to the bulk path
+          rxWp_ = 0;
+          memcpy(rxBuffer_, chunk + i, n - i);
+          receive(n - i);
           break;
+        }
+        receiveIncremental(chunk[i]);
       }
     }
 
+    while ((!IncrementalLexing || cobs()) && (avail = port_->available()) > 0) {
+      if (rxWp_ == RXBufferSize) {
+        // Frame is longer than the RX buffer; drop what we have and
+        // discard the remainder of the frame up to its terminator.
+        rxWp_ = 0;
+        rxDiscard_ = true;
+        if (Stats) stats_->droppedOverflow++;
+      }
+      int space = RXBufferSize - rxWp_;
+      int n = port_->readBytes(rxBuffer_ + rxWp_, avail < space ? avail : space);
+      if (n <= 0) break;
+      if (Stats) stats_->rxBytes += n;
+      receive(n);
+    }
+
     // Periodic reports
+    // Only streams that are due are visited. A stream that has fallen behind
+    // by more than its interval skips the missed reports, or under
+    // OVERRUN_CATCH_UP sends them at no more than one per tick: a stream
+    // still behind after its report is taken comes round again, and then
+    // it and any stream due after it wait for the next tick. When
+    // coalescing, all reports from this tick share one control stream
+    // frame: "0!reports 1:[...] 4:~[...]", where "~" marks a delta report.
+    //
+    // Under backpressure (see canNotify()) due reports are left in the
+    // schedule rather than written, and each is sent later, once, with
+    // the stream's value at that time.
+    uint32_t now = millis();
+    uint8_t slot = 0;
+    bool coalesced = false;
+    Bitset<MaxUserStreamCount> taken;  // slots already taken this tick
+    for (uint8_t n = reports_.count(); n > 0 && reports_.ready(now); n--) {
+      if (taken.test(reports_.next())) break;
+      if (!canNotify()) {
+        if (Stats) stats_->deferred++;
+        break;
+      }
+      reports_.due(now, &slot);
+      taken.set(slot);
+      if (!streams_[slot]->shouldReport()) {
+        if (Stats) stats_->suppressed++;
+        continue;
+      }
+      if (Stats) stats_->reports++;
+      if (!coalesceReports_) {
+        startNotification(slot + 1);
+        writeRaw(STR_REPORT);
+        if (streams_[slot]->deltaReport()) put('~');
+        writeSpace();
+        streams_[slot]->writeReport();
+        endFrame();
+        continue;
+      }
+      if (!coalesced) {
+        startNotification(0);
+        writeRaw(STR_REPORTS);
+        coalesced = true;
+      }
+      writeSpace();
+      writeStreamID(slot + 1);
+      put(':');
+      if (streams_[slot]->deltaReport()) put('~');
+      put('[');
+      streams_[slot]->writeReport();
+      put(']');
+    }
+    if (coalesced) {
+      endFrame();
+    }
+
+    if (Stats) {
+      uint32_t elapsed = micros() - tickStart;
+      if (elapsed > stats_->tickMax) stats_->tickMax = elapsed;
+    }
+  }
+
+ private:
+  // Process n bytes that have just been read into the RX buffer at rxWp_.
+  // Frames end at CR/LF, or at a 0x00 delimiter in COBS mode; the mode is
+  // checked per frame so that a transport switch takes effect immediately.
+  void receive(int n) {
+    int rp = rxWp_;       // scan position
+    int end = rxWp_ + n;  // end of valid data
+    int frameStart = 0;   // start of the current frame
+
+    // CRLF split across reads; swallow the LF.
+    if (rxState_ == 1 && !cobs()) {
+      rxState_ = 0;
+      if (rxBuffer_[rp] == '\n') {
+        frameStart = ++rp;
+      }
+    }
+
+    while (rp < end) {
+      bool cobsFrame = cobs();
+      int ix;
+      if (cobsFrame) {
+        const char *p = (const char *)memchr(rxBuffer_ + rp, 0, end - rp);
+        ix = p ? p - (rxBuffer_ + rp) : -1;
+      } else {
+        ix = findLineEnd(rxBuffer_ + rp, end - rp);
+      }
+      if (ix < 0) break;
+
+      // dispatch() overwrites the terminator with NUL, so note it first
+      int term = rp + ix;
+      char terminator = rxBuffer_[term];
+      if (rxDiscard_) {
+        rxDiscard_ = false;
+      } else if (cobsFrame) {
+        dispatchCOBS(rxBuffer_ + frameStart, term - frameStart);
+      } else {
+        dispatch(rxBuffer_ + frameStart, term - frameStart);
+      }
+
+      rp = term + 1;
+      if (!cobsFrame && terminator == '\r') {
+        if (rp == end) {
+          rxState_ = 1;
+        } else if (rxBuffer_[rp] == '\n') {
+          rp++;
+        }
+      }
+      frameStart = rp;
+    }
+
+    rxWp_ = end - frameStart;
+    if (rxWp_ > 0 && frameStart > 0) {
+      memmove(rxBuffer_, rxBuffer_ + frameStart, rxWp_);
+    }
+  }
 
-    if (reportInterval_ > 0) {
-      uint32_t now = millis();
-      if (now >= nextReportAt_) {
-        nextReportAt_ += reportInterval_;
-        for (int i = 0; i < MaxUserStreamCount; i++) {
-          if (reportStreams_ & (1 << i) && streams_[i]->shouldReport()) {
-            startNotification(i + 1);
-            writeRaw(F("report "));
-            streams_[i]->report();
-            endFrame();
+  // Process a single received byte in incremental mode. The frame header
+  // is decoded as it arrives, after which text bodies are fed to the lexer
+  // and binary bodies are hex-decoded straight into the RX buffer.
+  void receiveIncremental(char ch) {
+    if (rxState_ == 1) {
+      rxState_ = 0;
+      if (ch == '\n') return;
+    }
+
+    if (ch == '\r' || ch == '\n') {
+      if (ch == '\r') rxState_ = 1;
+      endIncrementalFrame();
+      return;
+    }
+
+    if (rxDiscard_) return;
+
+    switch (rxStage_) {
+      case RX_STREAM_ID:
+        if (extendedIDs()) {
+          rxStreamID_ = isNumeric(ch) ? ch - '0' : INVALID_HEXIT;
+        } else {
+          rxStreamID_ = decodeHexit(ch);
+        }
+        if (rxStreamID_ == INVALID_HEXIT) {
+          // Protocol violation - ignore the frame
+          rxDiscard_ = true;
+          if (Stats) stats_->droppedHexit++;
+        }
+        rxStage_ = RX_TYPE;
+        break;
+      case RX_TYPE:
+        if (extendedIDs() && isNumeric(ch)) {
+          // Further digits of an extended ID
+          rxStreamID_ = rxStreamID_ * 10 + ch - '0';
+          if (rxStreamID_ > 0xFF) {
+            rxDiscard_ = true;
+            if (Stats) stats_->droppedHexit++;
           }
+          break;
+        }
+        // As with dispatch(), any frame type marker is accepted
+        lexer_.reset();
+        rxStage_ = RX_BODY_START;
+        break;
+      case RX_BODY_START:
+        if (ch == '#') {
+          rxWp_ = 0;
+          rxStage_ = RX_BINARY_HIGH;
+          break;
+        } else if (ch == '@' && rxTagLen_ == 0) {
+          rxStage_ = RX_TAG;
+          break;
+        }
+        rxStage_ = RX_TEXT;
+        lexer_.feed(ch);
+        break;
+      case RX_TAG:
+        if (decodeHexit(ch) != INVALID_HEXIT && rxTagLen_ < TAG_MAX_LENGTH) {
+          rxTag_[rxTagLen_++] = ch;
+        } else if (rxTagLen_ > 0 && ch == ' ') {
+          rxStage_ = RX_BODY_START;
+        } else if (rxTagLen_ > 0 && ch == '#') {
+          rxWp_ = 0;
+          rxStage_ = RX_BINARY_HIGH;
+        } else {
+          // Not a tag after all; lex it as text, as dispatch() would
+          lexer_.feed('@');
+          for (uint8_t i = 0; i < rxTagLen_; i++) lexer_.feed(rxTag_[i]);
+          lexer_.feed(ch);
+          rxTagLen_ = 0;
+          rxStage_ = RX_TEXT;
+        }
+        break;
+      case RX_TEXT:
+        lexer_.feed(ch);
+        break;
+      default: {
+        uint8_t v = decodeHexit(ch);
+        if (v == INVALID_HEXIT) {
+          rxDiscard_ = true;
+          if (Stats) stats_->droppedBinary++;
+        } else if (rxWp_ == RXBufferSize) {
+          rxTooLong_ = true;
+        } else if (rxStage_ == RX_BINARY_HIGH) {
+          rxBuffer_[rxWp_] = v << 4;
+          rxStage_ = RX_BINARY_LOW;
+        } else {
+          rxBuffer_[rxWp_++] |= v;
+          rxStage_ = RX_BINARY_HIGH;
         }
+        break;
       }
     }
   }
 
- private:
-  void dispatch() {
-    if (rxWp_ < 2) {
+  // Dispatch the frame received in incremental mode, subject to the same
+  // validity rules as dispatch().
+  void endIncrementalFrame() {
+    uint8_t stage = rxStage_;
+    bool discard = rxDiscard_;
+    uint8_t tagLen = rxTagLen_;
+    bool tooLong = rxTooLong_;
+    rxStage_ = RX_STREAM_ID;
+    rxDiscard_ = false;
+    rxTagLen_ = 0;
+    rxTooLong_ = false;
+
+    if (stage == RX_TAG) {
+      // A tag with an empty body, or a lone '@'
+      if (tagLen == 0) lexer_.feed('@');
+      stage = RX_TEXT;
+    }
+
+    if (discard || stage < RX_BODY_START) {
+      // An empty line is not counted as a dropped frame
+      if (Stats && !discard && stage == RX_TYPE) stats_->droppedShort++;
+      return;
+    }
+
+    if (stage == RX_BINARY_HIGH || stage == RX_BINARY_LOW) {
+      int len = rxWp_;
+      rxWp_ = 0;
+      if (tooLong) {
+        rejectTooLong(tagLen);
+        return;
+      } else if (rxStreamID_ == 0 || stage == RX_BINARY_LOW) {
+        if (Stats) stats_->droppedBinary++;
+        return;
+      }
+      setTag(rxTag_, tagLen);
+      onStreamFrame(rxStreamID_, FRAME_TYPE_BINARY, rxBuffer_, len);
+      return;
+    }
+
+    lexer_.finish();
+    if (lexer_.overflowed()) {
+      rejectTooLong(tagLen);
+      return;
+    }
+
+    setTag(rxTag_, tagLen);
+    if (rxStreamID_ == 0) {
+      onControlStreamFrame(rxBuffer_, lexer_.length());
+    } else {
+      onStreamFrame(rxStreamID_, FRAME_TYPE_TEXT, rxBuffer_, lexer_.length());
+    }
+  }
+
+  // Reply to an incremental frame that did not fit in the RX buffer. Unlike
+  // the bulk path, the stream ID and tag have been kept, so the host can be
+  // told rather than left waiting.
+  void rejectTooLong(uint8_t tagLen) {
+    setTag(rxTag_, tagLen);
+    startMessage(rxStreamID_);
+    writeError(STR_ERR_TOO_LONG);
+    endFrame();
+    clearTag();
+  }
+
+  // Decode and verify a COBS frame of len bytes, then dispatch it.
+  void dispatchCOBS(char *frame, int len) {
+    int decodedLen = cobsDecode((uint8_t *)frame, len);
+    if (decodedLen < 4) {
+      // Too short to hold a header and CRC - ignore it
+      if (Stats) stats_->droppedShort++;
+      return;
+    }
+
+    decodedLen -= 2;
+    uint16_t crc = ((uint8_t)frame[decodedLen] << 8) | (uint8_t)frame[decodedLen + 1];
+    if (crc16((const uint8_t *)frame, decodedLen) != crc) {
+      // Corrupt frame - drop it
+      if (Stats) stats_->droppedCRC++;
+      return;
+    }
+
+    dispatch(frame, decodedLen);
+  }
+
+  // Dispatch a complete frame of len bytes. frame[len] is the frame's
+  // terminator, and may be overwritten. In COBS mode binary bodies are
+  // raw rather than hex-encoded.
+  void dispatch(char *frame, int len) {
+    if (len < 2) {
       // Invalid frame - ignore it. There's no point sending an error
-      // message if the client is giving us gibberish.
+      // message if the client is giving us gibberish. Empty lines are
+      // not counted.
+      if (Stats && len > 0) stats_->droppedShort++;
       return;
     }
 
-    uint8_t streamID = decodeHexit(rxBuffer_[0]);
-    if (streamID == INVALID_HEXIT) {
+    uint8_t streamID;
+    int idLen = decodeStreamID(frame, len, &streamID);
+    if (idLen == 0) {
       // Protocol violation - nothing to do
+      if (Stats) stats_->droppedHexit++;
       return;
     }
 
-    // According to the protocol, rxBuffer_[1] should be '<',
+    // According to the protocol, the ID should be followed by '<',
     // but we'll just accept anything.
+    int body = idLen + 1;
+    body += readTag(frame + body, len - body);
 
     // Check for a binary frame
-    if (rxWp_ >= 3 && rxBuffer_[2] == '#') {
+    if (len > body && frame[body] == '#') {
       if (streamID == 0) {
         // The control stream doesn't support binary frames
         // so we'll just ignore it.
         // TODO: send proper error message here? is there any point?
+        if (Stats) stats_->droppedBinary++;
+        clearTag();
         return;
       }
-      int len = decodeBinary();
-      if (len < 0) {
+      if (cobs()) {
+        onStreamFrame(streamID, FRAME_TYPE_BINARY, frame + body + 1, len - body - 1);
         return;
       }
-      onStreamFrame(streamID, FRAME_TYPE_BINARY, rxBuffer_, len);
+      int binaryLen = decodeBinary(frame, body + 1, len);
+      if (binaryLen < 0) {
+        if (Stats) stats_->droppedBinary++;
+        clearTag();
+        return;
+      }
+      onStreamFrame(streamID, FRAME_TYPE_BINARY, frame, binaryLen);
     } else {
-      rxBuffer_[rxWp_] = 0;
+      frame[len] = 0;
       if (streamID == 0) {
-        onControlStreamFrame(rxBuffer_ + 2, rxWp_ - 2);
+        onControlStreamFrame(frame + body, len - body);
       } else {
-        onStreamFrame(streamID, FRAME_TYPE_TEXT, rxBuffer_ + 2, rxWp_ - 2);
+        onStreamFrame(streamID, FRAME_TYPE_TEXT, frame + body, len - body);
       }
     }
   }
@@ -319,45 +1102,77 @@ class Protocol : public BaseProtocol {
   void onControlStreamFrame(char *data, int len) {
     ZAP_PARSE_ARGS(data, len);
     int err = 0;
+    int transport = -1;
+    if (Stats) stats_->frames++;
 
     startMessage(0);
 
     if (!args.scanWord(&arg)) {
       err = STR_ERR_INVALID_ARG;
-    } else if (streq(STR_REPORT, arg.S) == 0) {
-      updateReporting(&args);
-    } else if (streq(STR_HELLO, arg.S) == 0) {
-      writeRawSpace(STR_HELLO);
-      writeRaw(deviceInfo_);
-    } else if (streq(STR_STREAMS, arg.S) == 0) {
-      writeRawSpace(STR_STREAMS);
-      bool first = true;
-      for (int id = 1; id <= MaxUserStreamCount; id++) {
-        if (streams_[id - 1] == nullptr) continue;
-        if (!first) writeSpace();
-        first = false;
-        if (id <= 9) {
-          port_->write('0' + id);
-        } else {
-          port_->write('A' + id - 10);
-        }
-      }
-    } else if (streq(STR_DESC, arg.S) == 0) {
-      if (!args.scanInt(&arg)) {
-        err = STR_ERR_INVALID_ARG;
-      } else {
-        Stream *stream = lookupStreamByID(arg.I);
-        if (stream == nullptr) {
-          err = STR_ERR_UNKNOWN_ENTITY;
-        } else {
-          writeRawSpace(STR_DESC);
-          port_->print(arg.I, HEX);
-          writeSpace();
-          stream->describe();
+    } else {
+      switch (arg.id) {
+        case STR_REPORT:
+          updateReporting(&args);
+          break;
+        case STR_HELLO:
+          writeRawSpace(STR_HELLO);
+          writeRaw(deviceInfo_);
+          break;
+        case STR_STREAMS: {
+          writeRawSpace(STR_STREAMS);
+          bool first = true;
+          for (int id = 1; id <= maxStreamID(); id++) {
+            if (streams_[id - 1] == nullptr) continue;
+            if (!first) writeSpace();
+            first = false;
+            writeStreamID(id);
+          }
+          break;
         }
+        case STR_IDS:
+          err = updateIDs(&args);
+          break;
+        case STR_TRANSPORT:
+          if (args.end()) {
+            writeRawSpace(STR_TRANSPORT);
+            writeRaw(cobs() ? STR_COBS : STR_TEXT);
+          } else if (!args.scanWord(&arg)) {
+            err = STR_ERR_INVALID_ARG;
+          } else if (arg.id == STR_TEXT) {
+            transport = 0;
+            writeOK();
+          } else if (arg.id == STR_COBS) {
+            if (TXBufferSize < COBS_MAX_BLOCK) {
+              err = STR_ERR_NOT_IMPLEMENTED;
+            } else {
+              transport = 1;
+              writeOK();
+            }
+          } else {
+            err = STR_ERR_UNKNOWN_ENTITY;
+          }
+          break;
+        case STR_STATS:
+          err = reportStats(&args);
+          break;
+        case STR_DESC:
+          if (!scanStreamID(&args, &arg)) {
+            err = STR_ERR_INVALID_ARG;
+          } else {
+            Stream *stream = lookupStreamByID(arg.I);
+            if (stream == nullptr) {
+              err = STR_ERR_UNKNOWN_ENTITY;
+            } else {
+              writeRawSpace(STR_DESC);
+              writeStreamID(arg.I);
+              writeSpace();
+              stream->describe();
+            }
+          }
+          break;
+        default:
+          err = STR_ERR_UNKNOWN_COMMAND;
       }
-    } else {
-      err = STR_ERR_UNKNOWN_COMMAND;
     }
 
     if (err != 0) {
@@ -365,9 +1180,16 @@ class Protocol : public BaseProtocol {
     }
 
     endFrame();
+    clearTag();
+
+    // The reply to a transport change is sent using the old transport
+    if (transport >= 0) {
+      setCOBS(transport == 1);
+    }
   }
 
   void onStreamFrame(uint8_t streamID, uint8_t frameType, char *data, int len) {
+    if (Stats) stats_->frames++;
     startMessage(streamID);
     Stream *stream = lookupStreamByID(streamID);
     if (stream == nullptr) {
@@ -381,102 +1203,261 @@ class Protocol : public BaseProtocol {
       }
     }
     endFrame();
+    clearTag();
   }
 
+  // report on <interval> [<stream-ids>...]
+  // report off [<stream-ids>...]
+  // report coalesce [<bool>]
+  // report overrun [skip|catch-up]
+  //
+  // Each stream has its own interval; streams not mentioned are unaffected.
+  // Omitting the IDs applies the command to every stream.
   void updateReporting(ArgParser *p) {
     Arg arg;
+    uint16_t interval = 0;
 
-    if (!p->scanBool(&arg)) {
+    if (!p->next(&arg) || arg.named()) {
       writeError(STR_ERR_INVALID_ARG);
       return;
     }
 
-    if (!arg.B) {
-      reportInterval_ = 0;
-      writeOK();
+    if (arg.type == TOK_WORD && arg.id == STR_COALESCE) {
+      if (p->end()) {
+        writeRawSpace(STR_COALESCE);
+        write(coalesceReports_);
+      } else if (p->scanBool(&arg) && p->end()) {
+        coalesceReports_ = arg.B;
+        writeOK();
+      } else {
+        writeError(STR_ERR_INVALID_ARG);
+      }
       return;
-    }
-
-    if (!p->scanInt(&arg)) {
+    } else if (arg.type == TOK_WORD && arg.id == STR_OVERRUN) {
+      if (p->end()) {
+        writeRawSpace(STR_OVERRUN);
+        writeRaw(reports_.overrunPolicy() == OVERRUN_SKIP ? STR_SKIP : STR_CATCH_UP);
+      } else if (p->scanWord(&arg) && p->end() &&
+                 (arg.id == STR_SKIP || arg.id == STR_CATCH_UP)) {
+        reports_.setOverrunPolicy(arg.id == STR_SKIP ? OVERRUN_SKIP : OVERRUN_CATCH_UP);
+        writeOK();
+      } else {
+        writeError(STR_ERR_INVALID_ARG);
+      }
+      return;
+    } else if (arg.type != TOK_BOOL) {
       writeError(STR_ERR_INVALID_ARG);
       return;
     }
 
-    uint16_t interval = arg.I;
+    if (arg.B) {
+      if (!p->scanInt(&arg) || arg.I < 0 || arg.I > 0xFFFF) {
+        writeError(STR_ERR_INVALID_ARG);
+        return;
+      }
+      interval = arg.I;
+    }
 
-    uint16_t requestedStreams = 0;
+    // Validate every ID before changing anything
+    Bitset<MaxUserStreamCount> requested;
     if (p->end()) {
-      requestedStreams = 0x7FFF;
+      requested.setAll();
     } else {
       while (!p->end()) {
-        if (!p->scanInt(&arg)) {
+        if (!scanStreamID(p, &arg)) {
           writeError(STR_ERR_INVALID_ARG);
           return;
         }
-        uint8_t streamIndex = arg.I - 1;
-        if (streamIndex >= MaxUserStreamCount || !streams_[streamIndex]) {
+        if (lookupStreamByID(arg.I) == nullptr) {
           writeError(STR_ERR_UNKNOWN_ENTITY);
           return;
         }
-        requestedStreams |= (1 << streamIndex);
+        requested.set(arg.I - 1);
       }
     }
 
-    reportStreams_ = 0;
-    for (int i = 0; i < MaxUserStreamCount; i++) {
-      if ((requestedStreams & (1 << i)) && streams_[i] && streams_[i]->canReport()) {
-        reportStreams_ |= (1 << i);
+    uint32_t now = millis();
+    for (uint16_t i = requested.next(0); i < maxStreamID(); i = requested.next(i + 1)) {
+      if (streams_[i] && streams_[i]->canReport()) {
+        reports_.set(i, interval, now);
+      } else {
+        reports_.remove(i);
       }
     }
 
-    reportInterval_ = interval;
-    nextReportAt_ = millis() + interval;
-
     writeOK();
   }
 
-  Stream *lookupStreamByID(uint8_t streamID) {
-    if (streamID < 1 || streamID > MaxUserStreamCount) return nullptr;
-    return streams_[streamID - 1];
+  // ids [short|extended]
+  //
+  // Selects the stream ID encoding; see BaseProtocol. Streams above 15 stop
+  // reporting when short IDs are selected again. Returns an error code, or
+  // 0 once the reply is written.
+  int updateIDs(ArgParser *p) {
+    Arg arg;
+    if (p->end()) {
+      writeRawSpace(STR_IDS);
+      writeRaw(extendedIDs() ? STR_EXTENDED : STR_SHORT);
+      return 0;
+    } else if (!p->scanWord(&arg) || !p->end() ||
+               (arg.id != STR_SHORT && arg.id != STR_EXTENDED)) {
+      return STR_ERR_INVALID_ARG;
+    }
+    setExtendedIDs(arg.id == STR_EXTENDED);
+    for (uint8_t i = maxStreamID(); i < MaxUserStreamCount; i++) {
+      reports_.remove(i);
+    }
+    writeOK();
+    return 0;
   }
 
-  // Attempt to decode binary data in the RX buffer.
-  // Data is decoded in-place, writing begins at offset 0.
-  // Returns the length of the decoded data, or < 0 on error.
-  int decodeBinary() {
-    // we need an even number of hex digits, but since there is a 3-byte header,
-    // this equates to an odd number of bytes in the buffer.
-    if (rxWp_ % 2 != 1) {
-      return -1;
+  // stats
+  // stats reset
+  //
+  // The reply gives the counters in ProtocolStats, with error counts keyed
+  // by error code and the worst lateness and skipped periods of each
+  // stream that reports:
+  //
+  //   stats rx:<n> tx:<n> frames:<n>
+  //     dropped:[short:<n> hexit:<n> binary:<n> overflow:<n> crc:<n>]
+  //     errors:[<code>:<n> ...] reports:<n> suppressed:<n> deferred:<n>
+  //     tick-max:<us>
+  //     late:[<id>:<ms> ...] skipped:[<id>:<n> ...]
+  //
+  // Returns an error code, or 0 once the reply is written.
+  int reportStats(ArgParser *p) {
+    Arg arg;
+    if (!Stats) {
+      return STR_ERR_NOT_IMPLEMENTED;
+    } else if (!p->end()) {
+      if (!p->scanWord(&arg) || arg.id != STR_RESET || !p->end()) {
+        return STR_ERR_INVALID_ARG;
+      }
+      stats_->reset();
+      reports_.resetStats();
+      writeOK();
+      return 0;
+    }
+
+    // Snapshot first, so that the reply does not count itself
+    ProtocolStats s = *stats_;
+
+    writeRawSpace(STR_STATS);
+    writeStat(STR_RX, s.rxBytes);
+    writeStat(STR_TX, s.txBytes);
+    writeStat(STR_FRAMES, s.frames);
+    writeKey(STR_DROPPED);
+    put('[');
+    writeStat(STR_SHORT, s.droppedShort);
+    writeStat(STR_HEXIT, s.droppedHexit);
+    writeStat(STR_BINARY, s.droppedBinary);
+    writeStat(STR_OVERFLOW, s.droppedOverflow);
+    writeKey(STR_CRC);
+    writeUInt(s.droppedCRC);
+    put(']');
+    writeSpace();
+
+    writeKey(STR_ERRORS);
+    put('[');
+    bool first = true;
+    for (uint8_t i = 0; i < ERROR_STAT_COUNT; i++) {
+      if (s.errors[i] == 0) continue;
+      if (!first) writeSpace();
+      first = false;
+      writeKey(STR_ERR_INVALID_STREAM + i);
+      writeUInt(s.errors[i]);
     }
+    put(']');
+    writeSpace();
 
-    int wp = 0;
-    for (int rp = 3; rp < rxWp_; rp += 2) {
-      uint8_t high = decodeHexit(rxBuffer_[rp]);
-      uint8_t low = decodeHexit(rxBuffer_[rp + 1]);
-      if ((high | low) & 0x80) {
-        return -1;
+    writeStat(STR_REPORTS, s.reports);
+    writeStat(STR_SUPPRESSED, s.suppressed);
+    writeStat(STR_DEFERRED, s.deferred);
+    writeKey(STR_TICK_MAX);
+    writeUInt(s.tickMax);
+    writeSpace();
+
+    for (uint8_t pass = 0; pass < 2; pass++) {
+      if (pass > 0) writeSpace();
+      writeKey(pass == 0 ? STR_LATE : STR_SKIPPED);
+      put('[');
+      first = true;
+      for (uint8_t i = 0; i < MaxUserStreamCount; i++) {
+        if (!reports_.scheduled(i)) continue;
+        if (!first) writeSpace();
+        first = false;
+        writeStreamID(i + 1);
+        put(':');
+        writeUInt(pass == 0 ? reports_.maxLateness(i) : reports_.skipped(i));
       }
-      rxBuffer_[wp++] = (high << 4) | low;
+      put(']');
     }
-    return wp;
+    return 0;
+  }
+
+  // Write "<key>:<value> "
+  void writeStat(int key, uint32_t value) {
+    writeKey(key);
+    writeUInt(value);
+    writeSpace();
+  }
+
+  // Streams above 15 can only be reached with extended IDs
+  uint8_t maxStreamID() const {
+    return extendedIDs() || MaxUserStreamCount < 15 ? MaxUserStreamCount : 15;
+  }
+
+  Stream *lookupStreamByID(int streamID) {
+    if (streamID < 1 || streamID > maxStreamID()) return nullptr;
+    return streams_[streamID - 1];
+  }
+
+  // Attempt to decode binary data in a frame of len bytes, starting after
+  // the header of headerLen bytes. Data is decoded in-place, writing begins
+  // at offset 0. Returns the length of the decoded data, or < 0 on error.
+  int decodeBinary(char *frame, int headerLen, int len) {
+    // hexDecode() rejects an odd number of digits
+    return hexDecode(frame + headerLen, len - headerLen, (uint8_t *)frame);
   }
 
   // Receive buffer and state
   char rxBuffer_[RXBufferSize];  // Buffer
-  uint8_t rxState_ = 0;          // Receive state
+  uint8_t rxState_ = 0;          // Receive state (1 => last byte was CR)
   int rxWp_ = 0;                 // Write pointer
-
-  // Report configuration
-  uint16_t reportInterval_ = 0;  // interval (ms)
-  uint32_t nextReportAt_ = 0;    // scheduled time of next report (referenced to millis())
-  uint16_t reportStreams_ = 0;   // bitmask of streams that are reporting
+  bool rxDiscard_ = false;       // Discarding an overlong frame
+
+  // Incremental receive state
+  enum {
+    RX_STREAM_ID,    // expecting stream ID
+    RX_TYPE,         // expecting frame type marker
+    RX_BODY_START,   // expecting tag, binary indicator or start of text
+    RX_TAG,          // reading the hexits of a request tag
+    RX_TEXT,         // lexing text body
+    RX_BINARY_HIGH,  // expecting high nibble of binary body
+    RX_BINARY_LOW    // expecting low nibble of binary body
+  };
+  uint8_t rxStage_ = RX_STREAM_ID;
+  uint16_t rxStreamID_ = 0;  // wide enough to catch an overlong extended ID
+  char rxTag_[TAG_MAX_LENGTH];
+  uint8_t rxTagLen_ = 0;
+  bool rxTooLong_ = false;  // binary body overran the RX buffer
+  ArgLexer lexer_{rxBuffer_, RXBufferSize};
+
+  // Report schedule; slot i is logical stream i + 1
+  DeadlineScheduler<MaxUserStreamCount> reports_;
+  bool coalesceReports_ = false;  // send each tick's reports as one frame
 
   // Stream implementations
   // Index 0 is logical stream 1 since the control stream is implemented
   // by the Protocol class itself.
   Stream *streams_[MaxUserStreamCount] = {0};
 
+  // Counters; empty unless Stats is true
+  ProtocolStatsStore<Stats> statsStore_;
+
+  // Transmit frame buffer; unused when TXBufferSize is 0
+  uint8_t txBuffer_[TXBufferSize > 0 ? TXBufferSize : 1];
+
   // Device info
   IndifferentString deviceInfo_;
 };
@@ -0,0 +1,519 @@
+#pragma once
+
+namespace zap {
+
+// Router presents several downstream zap devices to a host as a single
+// device. It owns the upstream port and one port per downstream link, and
+// gives every downstream stream an ID in its own namespace:
+//
+//   host  <-- 1..N -->  Router  <-- link 0: 1 2 -->  device A
+//                               <-- link 1: 1 2 3 --> device B
+//
+// Stream frames are forwarded in both directions by rewriting the stream
+// ID digit in place; bodies are never parsed, so binary frames and
+// classes the router knows nothing about pass through unchanged.
+//
+// On begin() or refresh() the router asks each link for its streams and
+// their descriptions, and caches the results in a merged catalog that
+// answers the host's "streams" and "desc" requests. Until the catalog is
+// complete these return "busy". IDs are assigned in link order, so they
+// stay the same from one start to the next if the devices do.
+//
+// Control commands from the host:
+//
+//   hello             answered with the router's own device info
+//   streams, desc     answered from the catalog
+//   report on/off     forwarded to the links concerned, with their own IDs
+//   report overrun    forwarded to every link
+//   transport         text only
+//
+// Replies to forwarded commands are not waited for: the host gets "ok"
+// once the command is sent, and errors from the devices are dropped. A
+// reply that arrives after REPLY_TIMEOUT is taken for the next one due.
+// Control stream notifications from the devices are dropped too, as are
+// stream notifications while the host port is backed up (see
+// setNotifyHeadroom()). Links use the text transport.
+//
+// Template arguments:
+//   MaxLinks     - number of downstream links
+//   MaxRoutes    - number of downstream streams that can be routed (<= 15;
+//                  the router speaks short stream IDs on every port)
+//   FrameSize    - longest frame accepted on any port, and the size of each
+//                  port's receive buffer
+//   CatalogSize  - space for cached descriptions, shared by all streams
+template <uint8_t MaxLinks, uint8_t MaxRoutes = 15, uint8_t FrameSize = 96,
+          uint16_t CatalogSize = 512>
+class Router : public BaseProtocol {
+  static_assert(MaxRoutes <= 15, "the router only supports short stream IDs");
+
+ public:
+  // A device that has not answered a discovery request within this time
+  // (ms) is skipped
+  static const uint16_t REPLY_TIMEOUT = 500;
+
+  Router(::Stream *upstream, const IndifferentString deviceInfo)
+      : BaseProtocol(upstream), deviceInfo_(deviceInfo) {}
+
+  Router(::Stream *upstream, const char *deviceInfo)
+      : Router(upstream, IndifferentString(deviceInfo)) {}
+
+  Router(::Stream *upstream, const __FlashStringHelper *deviceInfo)
+      : Router(upstream, IndifferentString(deviceInfo)) {}
+
+  // Attach a downstream device. Returns the link's index, or -1 if all
+  // links are in use.
+  int addLink(::Stream *port) {
+    if (linkCount_ == MaxLinks) return -1;
+    links_[linkCount_].port = port;
+    return linkCount_++;
+  }
+
+  void begin() { refresh(); }
+
+  // Discard the catalog and enumerate every link again
+  void refresh() {
+    routeCount_ = 0;
+    catalogLen_ = 0;
+    pendingLinks_ = linkCount_;
+    pendingDescs_ = 0;
+    for (uint8_t i = 0; i < linkCount_; i++) {
+      Link &link = links_[i];
+      link.expectCount = 0;
+      link.streams.clear();
+      sendControl(i, EXPECT_STREAMS, 0);
+      linkWrite(i, STR_STREAMS, '\n');
+    }
+  }
+
+  // Returns true once the catalog is complete
+  bool ready() const { return pendingLinks_ == 0 && pendingDescs_ == 0; }
+
+  uint8_t routeCount() const { return routeCount_; }
+
+  void tick() {
+    while (port_->available() > 0) {
+      int len = upstream_.feed(port_->read());
+      if (len > 0) onHostFrame(upstream_.frame(), len);
+    }
+
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < linkCount_; i++) {
+      Link &link = links_[i];
+      while (link.port->available() > 0) {
+        int len = link.rx.feed(link.port->read());
+        if (len > 0) onDeviceFrame(i, link.rx.frame(), len);
+      }
+      if (link.expectCount > 0 && now - link.sentAt >= REPLY_TIMEOUT) {
+        onControlReply(i, nullptr, 0);
+      }
+    }
+  }
+
+ private:
+  // Collects a port's input into frames. Empty lines are ignored, and
+  // frames longer than FrameSize are discarded.
+  class FrameReader {
+   public:
+    // Add ch; returns the length of the frame it completes, or 0.
+    int feed(int ch) {
+      if (ch == '\r' || ch == '\n') {
+        int len = discard_ ? 0 : len_;
+        len_ = 0;
+        discard_ = false;
+        return len;
+      }
+      if (len_ == FrameSize) {
+        discard_ = true;
+      } else if (!discard_) {
+        buf_[len_++] = ch;
+      }
+      return 0;
+    }
+
+    // The last frame; there is room for one byte after it
+    char *frame() { return buf_; }
+
+   private:
+    char buf_[FrameSize + 1];
+    uint8_t len_ = 0;
+    bool discard_ = false;
+  };
+
+  // Expected replies on a link's control stream
+  enum { EXPECT_STREAMS, EXPECT_DESC, EXPECT_IGNORE };
+  static const uint8_t MAX_EXPECT = 4;
+
+  struct Link {
+    ::Stream *port = nullptr;
+    FrameReader rx;
+    Bitset<16> streams;             // local IDs found by discovery
+    uint8_t expect[MAX_EXPECT];     // replies due, oldest first
+    uint8_t expectArg[MAX_EXPECT];  // route index for EXPECT_DESC
+    uint8_t expectCount = 0;
+    uint32_t sentAt = 0;  // time the oldest expected reply was requested
+  };
+
+  struct Route {
+    uint8_t link;
+    uint8_t id;          // stream ID on the link
+    bool described;      // desc has been fetched (or given up on)
+    uint8_t descLen;     // length of the cached description
+    uint16_t descStart;  // offset of the cached description in catalog_
+  };
+
+  //
+  // Host side
+
+  void onHostFrame(char *frame, int len) {
+    uint8_t id = decodeHexit(frame[0]);
+    if (len < 2 || id == INVALID_HEXIT) {
+      return;
+    }
+
+    // Replies made here echo the request's tag; forwarded requests carry
+    // theirs to the device
+    int body = 2 + readTag(frame + 2, len - 2);
+
+    if (id == 0) {
+      if (len > body && frame[body] == '#') {
+        clearTag();
+        return;
+      }
+      frame[len] = 0;
+      onControlFrame(frame + body, len - body);
+      clearTag();
+      return;
+    }
+
+    if (id > routeCount_) {
+      startMessage(id);
+      writeError(STR_ERR_INVALID_STREAM);
+      endFrame();
+      clearTag();
+      return;
+    }
+    clearTag();
+
+    // Rewrite the ID and pass the frame on as it is
+    const Route &route = routes_[id - 1];
+    frame[0] = toHex(route.id);
+    frame[len] = '\n';
+    links_[route.link].port->write((const uint8_t *)frame, len + 1);
+  }
+
+  void onControlFrame(char *data, int len) {
+    ZAP_PARSE_ARGS(data, len);
+    int err = 0;
+
+    startMessage(0);
+
+    if (!args.scanWord(&arg)) {
+      err = STR_ERR_INVALID_ARG;
+    } else {
+      switch (arg.id) {
+        case STR_HELLO:
+          writeRawSpace(STR_HELLO);
+          writeRaw(deviceInfo_);
+          break;
+        case STR_STREAMS:
+          if (!ready()) {
+            err = STR_ERR_BUSY;
+            break;
+          }
+          writeRaw(STR_STREAMS);
+          for (uint8_t i = 1; i <= routeCount_; i++) {
+            writeSpace();
+            put(toHex(i));
+          }
+          break;
+        case STR_DESC:
+          if (!scanStreamID(&args, &arg)) {
+            err = STR_ERR_INVALID_ARG;
+          } else if (arg.I < 1 || arg.I > routeCount_) {
+            err = ready() ? STR_ERR_UNKNOWN_ENTITY : STR_ERR_BUSY;
+          } else if (!routes_[arg.I - 1].described) {
+            err = STR_ERR_BUSY;
+          } else {
+            const Route &route = routes_[arg.I - 1];
+            writeRawSpace(STR_DESC);
+            put(toHex(arg.I));
+            writeSpace();
+            put((const uint8_t *)catalog_ + route.descStart, route.descLen);
+          }
+          break;
+        case STR_REPORT:
+          err = forwardReporting(&args);
+          if (err == 0) writeOK();
+          break;
+        case STR_TRANSPORT:
+          if (args.end()) {
+            writeRawSpace(STR_TRANSPORT);
+            writeRaw(STR_TEXT);
+          } else if (!args.scanWord(&arg)) {
+            err = STR_ERR_INVALID_ARG;
+          } else if (arg.id == STR_TEXT) {
+            writeOK();
+          } else {
+            err = arg.id == STR_COBS ? STR_ERR_NOT_IMPLEMENTED : STR_ERR_UNKNOWN_ENTITY;
+          }
+          break;
+        default:
+          err = STR_ERR_UNKNOWN_COMMAND;
+      }
+    }
+
+    if (err != 0) {
+      writeError(err);
+    }
+    endFrame();
+  }
+
+  // report on <interval> [<stream-ids>...]
+  // report off [<stream-ids>...]
+  // report overrun <policy>
+  //
+  // Each link is sent the command for the streams it owns, or the command
+  // as it is if no IDs are given.
+  int forwardReporting(ArgParser *p) {
+    Arg arg;
+    if (!p->next(&arg) || arg.named()) {
+      return STR_ERR_INVALID_ARG;
+    }
+
+    if (arg.type == TOK_WORD && arg.id == STR_OVERRUN) {
+      if (!p->scanWord(&arg) || !p->end() ||
+          (arg.id != STR_SKIP && arg.id != STR_CATCH_UP)) {
+        return STR_ERR_INVALID_ARG;
+      }
+      uint8_t policy = arg.id;
+      for (uint8_t i = 0; i < linkCount_; i++) {
+        if (!sendControl(i, EXPECT_IGNORE, 0)) return STR_ERR_BUSY;
+        linkWrite(i, STR_REPORT, ' ');
+        linkWrite(i, STR_OVERRUN, ' ');
+        linkWrite(i, policy, '\n');
+      }
+      return 0;
+    } else if (arg.type != TOK_BOOL) {
+      return arg.type == TOK_WORD && arg.id == STR_COALESCE ? STR_ERR_NOT_IMPLEMENTED
+                                                            : STR_ERR_INVALID_ARG;
+    }
+
+    bool on = arg.B;
+    uint16_t interval = 0;
+    if (on) {
+      if (!p->scanInt(&arg) || arg.I < 0 || arg.I > 0xFFFF) {
+        return STR_ERR_INVALID_ARG;
+      }
+      interval = arg.I;
+    }
+
+    // Collect the requested streams of each link, validating every ID
+    // before anything is sent
+    Bitset<16> requested[MaxLinks];
+    bool all = p->end();
+    while (!p->end()) {
+      if (!scanStreamID(p, &arg)) {
+        return STR_ERR_INVALID_ARG;
+      } else if (arg.I < 1 || arg.I > routeCount_) {
+        return STR_ERR_UNKNOWN_ENTITY;
+      }
+      const Route &route = routes_[arg.I - 1];
+      requested[route.link].set(route.id);
+    }
+
+    for (uint8_t i = 0; i < linkCount_; i++) {
+      if (!all && !requested[i].any()) continue;
+      if (!sendControl(i, EXPECT_IGNORE, 0)) return STR_ERR_BUSY;
+      linkWrite(i, STR_REPORT, ' ');
+      linkWrite(i, on ? STR_TRUE : STR_FALSE, on || !all ? ' ' : '\n');
+      if (on) {
+        char buf[INT_FORMAT_MAX];
+        char *start = formatUInt(interval, buf + sizeof(buf));
+        links_[i].port->write((const uint8_t *)start, buf + sizeof(buf) - start);
+        links_[i].port->write(all ? '\n' : ' ');
+      }
+      if (all) continue;
+      bool first = true;
+      for (uint8_t id = requested[i].next(1); id < 16; id = requested[i].next(id + 1)) {
+        if (!first) links_[i].port->write(' ');
+        first = false;
+        links_[i].port->write(toHex(id));
+      }
+      links_[i].port->write('\n');
+    }
+    return 0;
+  }
+
+  //
+  // Device side
+
+  void onDeviceFrame(uint8_t link, char *frame, int len) {
+    uint8_t id = decodeHexit(frame[0]);
+    if (len < 2 || id == INVALID_HEXIT) {
+      return;
+    }
+
+    if (id == 0) {
+      if (frame[1] == '>') {
+        frame[len] = 0;
+        onControlReply(link, frame + 2, len - 2);
+      }
+      return;
+    }
+
+    uint8_t global = routeOf(link, id);
+    if (global == 0) return;
+    // Notifications cannot be held here, so under backpressure they are
+    // dropped; a report is superseded by the next, and capture chunks
+    // carry sequence numbers
+    if (frame[1] == '!' && !canNotify()) return;
+    put(toHex(global));
+    put((const uint8_t *)frame + 1, len - 1);
+    endFrame();
+  }
+
+  // Handle the reply to the oldest request sent to link's control stream.
+  // A null body means the request timed out.
+  void onControlReply(uint8_t link, const char *body, int len) {
+    Link &l = links_[link];
+    if (l.expectCount == 0) return;
+
+    uint8_t expect = l.expect[0];
+    uint8_t expectArg = l.expectArg[0];
+    l.expectCount--;
+    for (uint8_t i = 0; i < l.expectCount; i++) {
+      l.expect[i] = l.expect[i + 1];
+      l.expectArg[i] = l.expectArg[i + 1];
+    }
+    l.sentAt = millis();
+
+    if (expect == EXPECT_STREAMS) {
+      // "streams 1 2 4"
+      if (body != nullptr && startsWith(body, len, STR_STREAMS)) {
+        for (int i = 7; i < len; i++) {
+          uint8_t id = decodeHexit(body[i]);
+          if (id != INVALID_HEXIT && id != 0) l.streams.set(id);
+        }
+      }
+      if (--pendingLinks_ == 0) {
+        assignRoutes();
+      }
+    } else if (expect == EXPECT_DESC) {
+      // "desc <id> <description>"
+      Route &route = routes_[expectArg];
+      route.described = true;
+      pendingDescs_--;
+      // The description is only kept if the reply names the stream asked
+      // about; a late reply can leave replies and requests out of step.
+      if (body != nullptr && len > 7 && startsWith(body, len, STR_DESC) && body[6] == ' ' &&
+          decodeHexit(body[5]) == route.id) {
+        const char *desc = body + 7;
+        int descLen = len - 7;
+        if (descLen <= 0xFF && catalogLen_ + descLen <= CatalogSize) {
+          memcpy(catalog_ + catalogLen_, desc, descLen);
+          route.descStart = catalogLen_;
+          route.descLen = descLen;
+          catalogLen_ += descLen;
+        }
+      }
+      requestDesc(link);
+    }
+  }
+
+  // Give every discovered stream an ID, in link order, then start fetching
+  // descriptions
+  void assignRoutes() {
+    for (uint8_t i = 0; i < linkCount_; i++) {
+      const Bitset<16> &streams = links_[i].streams;
+      for (uint8_t id = streams.next(1); id < 16 && routeCount_ < MaxRoutes;
+           id = streams.next(id + 1)) {
+        Route &route = routes_[routeCount_++];
+        route.link = i;
+        route.id = id;
+        route.described = false;
+        route.descLen = 0;
+        route.descStart = 0;
+        pendingDescs_++;
+      }
+    }
+    for (uint8_t i = 0; i < linkCount_; i++) {
+      requestDesc(i);
+    }
+  }
+
+  // Ask link for the next description it owes, one at a time so that a
+  // small device receive buffer is never overrun
+  void requestDesc(uint8_t link) {
+    for (uint8_t r = 0; r < routeCount_; r++) {
+      const Route &route = routes_[r];
+      if (route.link != link || route.described) continue;
+      if (!sendControl(link, EXPECT_DESC, r)) return;
+      linkWrite(link, STR_DESC, ' ');
+      links_[link].port->write(toHex(route.id));
+      links_[link].port->write('\n');
+      return;
+    }
+  }
+
+  // Start a request on link's control stream, noting the reply it expects.
+  // Returns false if too many replies are outstanding.
+  bool sendControl(uint8_t link, uint8_t expect, uint8_t expectArg) {
+    Link &l = links_[link];
+    if (l.expectCount == MAX_EXPECT) return false;
+    if (l.expectCount == 0) l.sentAt = millis();
+    l.expect[l.expectCount] = expect;
+    l.expectArg[l.expectCount] = expectArg;
+    l.expectCount++;
+    l.port->write('0');
+    l.port->write('<');
+    return true;
+  }
+
+  // Write a string table entry to link, followed by sep
+  void linkWrite(uint8_t link, int strTableIx, char sep) {
+    ::Stream *port = links_[link].port;
+    const char *str = strptr(strTableIx);
+#if ZAP_FLASH_ACCESSORS
+    for (int i = 0;; i++) {
+      const char b = pgm_read_byte_near(str + i);
+      if (b == 0) break;
+      port->write(b);
+    }
+#else
+    port->write((const uint8_t *)str, strlength(strTableIx));
+#endif
+    port->write(sep);
+  }
+
+  // Returns true if body[0..len) begins with the string table entry and a
+  // space or the end of the body
+  static bool startsWith(const char *body, int len, int strTableIx) {
+    int n = strlength(strTableIx);
+    return len >= n && strncmp_P(body, strptr(strTableIx), n) == 0 &&
+           (len == n || body[n] == ' ');
+  }
+
+  // Returns the router's ID for stream id of link, or 0
+  uint8_t routeOf(uint8_t link, uint8_t id) const {
+    for (uint8_t i = 0; i < routeCount_; i++) {
+      if (routes_[i].link == link && routes_[i].id == id) return i + 1;
+    }
+    return 0;
+  }
+
+  FrameReader upstream_;
+  Link links_[MaxLinks];
+  uint8_t linkCount_ = 0;
+
+  // Catalog
+  Route routes_[MaxRoutes];  // route i is the router's stream i + 1
+  uint8_t routeCount_ = 0;
+  uint8_t pendingLinks_ = 0;  // links yet to list their streams
+  uint8_t pendingDescs_ = 0;  // routes yet to be described
+  char catalog_[CatalogSize];
+  uint16_t catalogLen_ = 0;
+
+  IndifferentString deviceInfo_;
+};
+
+};  // namespace zap
@@ -0,0 +1,176 @@
+#pragma once
+
+namespace zap {
+
+// What DeadlineScheduler does with periods missed while the caller was
+// busy for longer than a slot's interval
+enum OverrunPolicy {
+  OVERRUN_SKIP,     // drop the missed periods and run once
+  OVERRUN_CATCH_UP  // run once for every missed period, one per due() call
+};
+
+// DeadlineScheduler runs up to N periodic jobs, each identified by a slot
+// number 0..N-1 and with its own interval. Pending deadlines are kept in a
+// binary min-heap so that finding the jobs that are due costs O(1) when
+// nothing is due and O(log N) per job that is, regardless of how many
+// slots are in use.
+//
+// Deadlines are referenced to millis() and advance by exactly one interval
+// per period, so the schedule does not drift however late the caller is.
+// Times are compared by their signed difference, which stays correct
+// across the wrap of millis() every ~49 days. Each slot records its worst
+// lateness and the number of periods skipped, so that jitter can be
+// measured.
+template <uint8_t N>
+class DeadlineScheduler {
+ public:
+  DeadlineScheduler() { clear(); }
+
+  // Unschedule all slots
+  void clear() {
+    size_ = 0;
+    for (uint8_t i = 0; i < N; i++) {
+      interval_[i] = 0;
+      pos_[i] = NONE;
+    }
+    resetStats();
+  }
+
+  OverrunPolicy overrunPolicy() const { return policy_; }
+  void setOverrunPolicy(OverrunPolicy policy) { policy_ = policy; }
+
+  // Schedule slot to run every interval ms, the first time at now + interval.
+  // An interval of zero unschedules the slot.
+  void set(uint8_t slot, uint16_t interval, uint32_t now) {
+    remove(slot);
+    if (interval == 0) return;
+    interval_[slot] = interval;
+    deadline_[slot] = now + interval;
+    heap_[size_] = slot;
+    pos_[slot] = size_;
+    siftUp(size_++);
+  }
+
+  // Unschedule slot
+  void remove(uint8_t slot) {
+    uint8_t ix = pos_[slot];
+    interval_[slot] = 0;
+    if (ix == NONE) return;
+    pos_[slot] = NONE;
+    if (ix == --size_) return;
+    move(heap_[size_], ix);
+    siftDown(ix);
+    siftUp(ix);
+  }
+
+  // If a slot is due at time now, store it in slot, advance its deadline,
+  // and return true. Call repeatedly to drain all due slots. If late is
+  // given it receives the time since the slot's deadline, in ms.
+  bool due(uint32_t now, uint8_t *slot, uint32_t *late = nullptr) {
+    if (!ready(now)) return false;
+    uint8_t s = heap_[0];
+    int32_t lateness = (int32_t)(now - deadline_[s]);
+
+    uint32_t advance = interval_[s];
+    if (lateness >= interval_[s] && policy_ == OVERRUN_SKIP) {
+      // Move to the first period still in the future
+      uint32_t missed = (uint32_t)lateness / interval_[s];
+      advance += missed * interval_[s];
+      skipped_[s] = skipped_[s] + missed > 0xFFFF ? 0xFFFF : skipped_[s] + missed;
+    }
+    deadline_[s] += advance;
+    siftDown(0);
+
+    if ((uint32_t)lateness > maxLate_[s]) {
+      maxLate_[s] = lateness > 0xFFFF ? 0xFFFF : lateness;
+    }
+    if (late) *late = lateness;
+    *slot = s;
+    return true;
+  }
+
+  // The slot that due() takes next; only meaningful while ready()
+  uint8_t next() const { return heap_[0]; }
+
+  // Returns true if a slot is due at time now, without taking it
+  bool ready(uint32_t now) const {
+    return size_ > 0 && (int32_t)(now - deadline_[heap_[0]]) >= 0;
+  }
+
+  // Worst lateness of slot since the last resetStats(), in ms (saturates)
+  uint16_t maxLateness(uint8_t slot) const { return maxLate_[slot]; }
+
+  // Periods of slot dropped under OVERRUN_SKIP since the last resetStats()
+  // (saturates)
+  uint16_t skipped(uint8_t slot) const { return skipped_[slot]; }
+
+  void resetStats() {
+    for (uint8_t i = 0; i < N; i++) {
+      maxLate_[i] = 0;
+      skipped_[i] = 0;
+    }
+  }
+
+  bool scheduled(uint8_t slot) const { return pos_[slot] != NONE; }
+  bool empty() const { return size_ == 0; }
+  uint8_t count() const { return size_; }
+  uint16_t interval(uint8_t slot) const { return interval_[slot]; }
+
+ private:
+  static const uint8_t NONE = 0xFF;
+  static_assert(N < NONE, "slot numbers and heap indices must not reach NONE");
+
+  // Pending deadlines are far less than 2^31 ms apart, so the sign of
+  // their difference orders them even across a wrap
+  bool before(uint8_t a, uint8_t b) const {
+    return (int32_t)(deadline_[heap_[a]] - deadline_[heap_[b]]) < 0;
+  }
+
+  void move(uint8_t slot, uint8_t ix) {
+    heap_[ix] = slot;
+    pos_[slot] = ix;
+  }
+
+  void swap(uint8_t a, uint8_t b) {
+    uint8_t s = heap_[a];
+    move(heap_[b], a);
+    move(s, b);
+  }
+
+  void siftUp(uint8_t ix) {
+    while (ix > 0) {
+      uint8_t parent = (ix - 1) / 2;
+      if (!before(ix, parent)) break;
+      swap(ix, parent);
+      ix = parent;
+    }
+  }
+
+  void siftDown(uint8_t ix) {
+    while (true) {
+      // Children of indices from 128 up lie beyond 255, so the arithmetic
+      // is done wide and narrowed only once a child is known to be in use.
+      // size_ never exceeds N, but the compiler cannot tell, and warns of
+      // reads past heap_ unless the children are also checked against N.
+      uint8_t least = ix;
+      uint16_t left = 2 * (uint16_t)ix + 1;
+      uint16_t right = left + 1;
+      if (left < N && left < size_ && before(left, least)) least = left;
+      if (right < N && right < size_ && before(right, least)) least = right;
+      if (least == ix) break;
+      swap(ix, least);
+      ix = least;
+    }
+  }
+
+  uint32_t deadline_[N];  // next deadline of each slot
+  uint16_t interval_[N];  // interval of each slot (ms); 0 if unscheduled
+  uint8_t pos_[N];        // heap index of each slot, or NONE
+  uint8_t heap_[N];       // min-heap of slots ordered by deadline
+  uint8_t size_;          // number of scheduled slots
+  uint16_t maxLate_[N];   // worst lateness of each slot (ms)
+  uint16_t skipped_[N];   // periods dropped by each slot
+  OverrunPolicy policy_ = OVERRUN_SKIP;
+};
+
+};  // namespace zap
@@ -0,0 +1,51 @@
+#pragma once
+
+namespace zap {
+
+// Number of STR_ERR_ codes, which are contiguous in the string table
+const uint8_t ERROR_STAT_COUNT = STR_ERR_TOO_LONG - STR_ERR_INVALID_STREAM + 1;
+
+// Counters kept by a Protocol built with Stats enabled, and reported by
+// the "stats" control command. Byte, frame, and report counts wrap at
+// 2^32; drop and error counts at 2^16.
+struct ProtocolStats {
+  uint32_t rxBytes = 0;     // bytes read from the port
+  uint32_t txBytes = 0;     // bytes written to the port
+  uint32_t frames = 0;      // frames dispatched to a stream
+
+  // Frames dropped without a reply
+  uint16_t droppedShort = 0;     // too short to hold a header
+  uint16_t droppedHexit = 0;     // stream ID is invalid
+  uint16_t droppedBinary = 0;    // malformed binary body
+  uint16_t droppedOverflow = 0;  // did not fit the RX buffer
+  uint16_t droppedCRC = 0;       // COBS frame failed its CRC
+
+  // Error replies, indexed by STR_ERR_ code - STR_ERR_INVALID_STREAM
+  uint16_t errors[ERROR_STAT_COUNT] = {0};
+
+  uint32_t reports = 0;     // periodic reports sent
+  uint32_t suppressed = 0;  // periodic reports declined by shouldReport()
+  uint32_t deferred = 0;    // ticks on which due reports waited for the port
+  uint32_t tickMax = 0;     // longest Protocol::tick(), in us
+
+  void reset() { *this = ProtocolStats(); }
+
+  void countError(int id) {
+    uint8_t ix = id - STR_ERR_INVALID_STREAM;
+    if (ix < ERROR_STAT_COUNT) errors[ix]++;
+  }
+};
+
+// Storage for a Protocol's stats; empty unless Enabled
+template <bool Enabled>
+struct ProtocolStatsStore {
+  ProtocolStats *get() { return &stats; }
+  ProtocolStats stats;
+};
+
+template <>
+struct ProtocolStatsStore<false> {
+  ProtocolStats *get() { return nullptr; }
+};
+
+};  // namespace zap
@@ -2,50 +2,6 @@
 
 namespace zap {
 
-class Stream {
- public:
-  virtual void describe() = 0;
-
-  // Handle an incoming message.
-  //
-  // Before invocation, the caller will start a reply frame by writing
-  // "{$streamID}>" to the serial port. After invocation, the frame
-  // is terminated with a newline.
-  //
-  // handleMessage() uses the return value to control what additional
-  // reply is written by the caller.
-  //
-  // Return values:
-  //
-  // 0   - operation succeeded, caller will write "ok" response
-  // >0  - error; return value is assumed to be index into string table
-  //       representing the error code
-  // -1  - handleMessage() has written a response; call should take no
-  //       further action (save for ending the frame with a newline).
-  //
-  virtual int handleMessage(uint8_t frameType, char *data, int len) = 0;
-
-  // Returns true if this stream is capable of emitting periodic reports
-  virtual bool canReport() { return false; }
-
-  // Returns true if this stream should send a report right now.
-  // This method can be overridden, for example, to mute reports
-  // if the sensor is disabled, or to only send reports if the
-  // underlying value has changed.
-  virtual bool shouldReport() { return true; }
-
-  virtual void report() {}
-
-  void setProtocol(BaseProtocol *p, uint8_t id) {
-    proto = p;
-    streamID = id;
-  }
-
- protected:
-  BaseProtocol *proto;
-  uint8_t streamID;
-};
-
 class ModeSelector : public Stream {
  public:
   ModeSelector(char **modeNames, uint8_t modeCount)
@@ -59,7 +15,7 @@ class ModeSelector : public Stream {
       if (i > 0) proto->writeSpace();
       proto->writeRaw(names_[i]);
     }
-    proto->port()->write(']');
+    proto->out()->write(']');
   }
 
   int handleMessage(uint8_t frameType, char *data, int len) {
@@ -67,7 +23,7 @@ class ModeSelector : public Stream {
 
     if (!args.scanWord(&arg)) {
       return STR_ERR_INVALID_ARG;
-    } else if (!streq(STR_MODE, arg.S)) {
+    } else if (arg.id != STR_MODE) {
       return STR_ERR_UNKNOWN_COMMAND;
     }
 
@@ -150,7 +106,7 @@ class Ident : public Stream {
     }
   }
 
-  bool setEnabled(bool isEnabled) { digitalWrite(pin_, isEnabled == polarity_); }
+  void setEnabled(bool isEnabled) { digitalWrite(pin_, isEnabled == polarity_); }
 
  private:
   uint8_t pin_;    // pin used for ident
@@ -181,12 +137,18 @@ class DeviceSelector : public Stream {
     bool currentState = digitalRead(pin_) == polarity_;
     if (currentState != active_) {
       if (currentState) {
-        proto->startNotification(streamID);
-        proto->writeRaw(F("select"));
-        proto->endFrame();
+        pending_ = true;
       }
       active_ = currentState;
     }
+
+    // A selection waits while the port is backed up (see canNotify())
+    if (pending_ && proto->canNotify()) {
+      proto->startNotification(streamID);
+      proto->writeRaw(F("select"));
+      proto->endFrame();
+      pending_ = false;
+    }
   }
 
   void describe() { proto->writeRaw(F("class:deviceSelect")); }
@@ -206,29 +168,40 @@ class DeviceSelector : public Stream {
   void setEnabled(bool isEnabled) {
     enabled_ = isEnabled;
     active_ = false;
+    pending_ = false;
   }
 
   bool enabled_ = false;  // is selection enabled?
   bool active_ = false;   // was select pin active on last tick?
+  bool pending_ = false;  // selection not yet notified
   uint8_t pin_;           // pin used for detecting selection
   bool polarity_;         // active polarity of select pin
 };
 
-template <typename T>
-class ScalarSensorStream : public Stream {
+// SensorStream is the base of the sensor streams below. It holds the
+// enabled and valid flags, the reporting policy and the stream's settings,
+// and handles the "read", "enable" and "set" commands. Derived provides
+//
+//   void writeValues()                           write the current value(s)
+//   void resetReporting()                        start reporting afresh
+//   static int setPolicy(Policy *, const Arg &)  stage a policy key
+//
+// setPolicy() returns 1 if arg was a valid policy setting, 0 if it is not a
+// policy key, or -1 if its value is invalid. resetReporting() is called
+// when the stream is enabled and when the policy changes. Policy must
+// support ==, so that a "set" that leaves it alone does not reset it.
+//
+// A stream's own settings are kept in a Config struct whose members are
+// bound to keys by a ConfigSchema (see zap_config.hpp). "set" stages keys
+// in a copy of the struct and replaces config() only if every key in the
+// transaction is valid; describeConfig() writes the matching desc key.
+template <typename Derived, typename Policy, typename Config>
+class SensorStream : public Stream {
  public:
-  ScalarSensorStream() : enabled_(false), valid_(false), value_(T{}) {}
+  typedef Policy ReportPolicy;
 
   inline bool enabled() { return enabled_; }
   inline bool valid() { return valid_; }
-  inline T value() { return value_; }
-
-  void setValue(T v) {
-    if (enabled_) {
-      value_ = v;
-      valid_ = true;
-    }
-  }
 
   void invalidate() { valid_ = false; }
 
@@ -236,6 +209,7 @@ class ScalarSensorStream : public Stream {
     if (!enabled_) {
       setEnabled(true);
       enabled_ = true;
+      derived()->resetReporting();
     }
   }
 
@@ -247,8 +221,20 @@ class ScalarSensorStream : public Stream {
     }
   }
 
+  const Policy &reportPolicy() { return policy_; }
+
+  const Config &config() const { return config_; }
+
+  void setReportPolicy(const Policy &policy) {
+    policy_ = policy;
+    derived()->resetReporting();
+  }
+
   bool canReport() { return true; }
-  bool shouldReport() { return valid_; }
+
+  // Writes the current value(s). Subclasses may override this to format
+  // the value themselves; full periodic reports go through it too.
+  void report() { derived()->writeValues(); }
 
   int handleMessage(uint8_t frameType, char *data, int len) {
     ZAP_PARSE_ARGS(data, len);
@@ -257,45 +243,70 @@ class ScalarSensorStream : public Stream {
       return STR_ERR_INVALID_ARG;
     }
 
-    if (streq(STR_READ, arg.S) == 0) {
-      if (!valid_) {
-        return STR_ERR_NO_VALUE;
-      } else {
+    switch (arg.id) {
+      case STR_READ:
+        if (!valid_) {
+          return STR_ERR_NO_VALUE;
+        }
         proto->writeRawSpace(STR_READ);
         report();
-      }
-      return 0;
-    }
-
-    if (streq(STR_ENABLE, arg.S) == 0) {
-      if (args.end()) {
-        proto->writeRawSpace(STR_ENABLE);
-        proto->write(enabled_);
         return -1;
-      } else if (args.scanBool(&arg)) {
-        if (arg.B) {
-          enable();
+
+      case STR_ENABLE:
+        if (args.end()) {
+          proto->writeRawSpace(STR_ENABLE);
+          proto->write(enabled_);
+          return -1;
+        } else if (args.scanBool(&arg)) {
+          if (arg.B) {
+            enable();
+          } else {
+            disable();
+          }
+          return 0;
         } else {
-          disable();
+          return STR_ERR_INVALID_ARG;
         }
-        return 0;
-      } else {
-        return STR_ERR_INVALID_ARG;
-      }
-    }
 
-    if (streq(STR_SET, arg.S) == 0) {
-      beginConfig();
-      bool aborted = false;
-      while (!args.end()) {
-        if (!args.next(&arg)) {
-          aborted = true;
-          break;
-        } else if (arg.key != nullptr) {
-          setConfig(arg);
+      case STR_SET: {
+        // Policy and schema keys are staged and applied only if the
+        // whole transaction succeeds; other keys go to setConfig().
+        Policy policy = policy_;
+        Config config = config_;
+        beginConfig();
+        bool aborted = false;
+        while (!args.end()) {
+          if (!args.next(&arg)) {
+            aborted = true;
+            break;
+          } else if (arg.key == nullptr) {
+            continue;
+          }
+          int res = Derived::setPolicy(&policy, arg);
+          if (res == 0 && !IsNoConfig<Config>::value) {
+            res = schema_.set(&config, arg);
+          }
+          if (res < 0) {
+            aborted = true;
+            break;
+          } else if (res == 0) {
+            setConfig(arg);
+          }
+        }
+        if (!commitConfig(aborted)) {
+          return -1;
+        } else if (!aborted) {
+          // Applying a policy restarts reporting, so only do so if it changed
+          if (!(policy == policy_)) {
+            setReportPolicy(policy);
+          }
+          if (schema_.count() > 0) {
+            config_ = config;
+            configChanged();
+          }
         }
+        return 0;
       }
-      return commitConfig(aborted) ? 0 : -1;
     }
 
     return STR_ERR_UNKNOWN_COMMAND;
@@ -330,11 +341,683 @@ class ScalarSensorStream : public Stream {
   //
   // On failure, returns false, and it is this method's responsibility to
   // write the appropriate error code to the stream.
-  virtual bool commitConfig(bool aborted) {}
+  virtual bool commitConfig(bool aborted) {
+    if (aborted) {
+      proto->writeError(STR_ERR_INVALID_ARG);
+    }
+    return !aborted;
+  }
+
+  // Called after a "set" transaction has replaced config()
+  virtual void configChanged() {}
+
+ protected:
+  SensorStream() : enabled_(false), valid_(false) {}
+
+  SensorStream(const ConfigSchema &schema, const Config &defaults)
+      : enabled_(false), valid_(false), schema_(schema), config_(defaults) {}
+
+  // Write the "config" desc key for the schema, preceded by a space; call
+  // from describe(). Writes nothing if the stream has no schema.
+  void describeConfig() {
+    if (schema_.count() > 0) {
+      proto->writeSpace();
+      schema_.describe(proto);
+    }
+  }
+
+  // Convert a non-negative numeric arg to a value
+  template <typename V>
+  static bool toValue(const Arg &arg, V *dst) {
+    if (arg.type == TOK_INT && arg.I >= 0) {
+      *dst = (V)arg.I;
+    } else if (arg.type == TOK_FLOAT && arg.F >= 0) {
+      *dst = (V)arg.F;
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  // Integers are written with the table-driven formatters rather than
+  // through Print.
+  void writeValue(float v) { proto->write(v); }
+  void writeValue(double v) { proto->write((float)v); }
+
+  template <typename U>
+  void writeValue(U v) {
+    proto->writeInteger(v);
+  }
 
- private:
   bool enabled_;
   bool valid_;
+  Policy policy_;
+
+ private:
+  Derived *derived() { return static_cast<Derived *>(this); }
+
+  ConfigSchema schema_;
+  Config config_;
+};
+
+template <typename T>
+struct ScalarReportPolicy {
+  bool onChange = false;
+  T deadband = 0;
+  float relDeadband = 0;  // percent
+  T hysteresis = 0;
+  uint16_t minInterval = 0;  // ms
+  uint16_t maxSilence = 0;   // ms; 0 disables the heartbeat
+  bool aggregate = false;
+  bool variance = false;
+
+  bool operator==(const ScalarReportPolicy &o) const {
+    return onChange == o.onChange && deadband == o.deadband && relDeadband == o.relDeadband &&
+           hysteresis == o.hysteresis && minInterval == o.minInterval &&
+           maxSilence == o.maxSilence && aggregate == o.aggregate && variance == o.variance;
+  }
+};
+
+// ScalarSensorStream reports a single value. By default every scheduled
+// report is sent; the reporting policy, set with the "set" command, can
+// instead send reports only when the value changes:
+//
+//   on-change:<bool>      only report changes (plus heartbeats)
+//   deadband:<n>          ignore changes of n or less
+//   deadband-rel:<pct>    ignore changes of pct% of the last report or less
+//   hysteresis:<n>        a change of direction must exceed the deadband by n
+//   min-interval:<ms>     never report more often than this
+//   max-silence:<ms>      with on-change, report at least this often
+//   aggregate:<bool>      report a summary of the samples since the last
+//                         report in place of the current value
+//   variance:<bool>       include the sample variance in the summary
+//
+// Deadband and hysteresis are in the units of the value. The policy is
+// only checked when the stream's report is scheduled, so the report
+// interval sets the sampling rate. On-change reporting follows the
+// current value even when aggregating.
+//
+// Aggregate reports have the form
+//
+//   count:<n> min:<v> max:<v> mean:<v> [variance:<v>]
+//
+// and summarise every setValue() in the window, however fast the sensor
+// is sampled. Each window costs O(1) memory.
+template <typename T, typename Config = NoConfig>
+class ScalarSensorStream
+    : public SensorStream<ScalarSensorStream<T, Config>, ScalarReportPolicy<T>, Config> {
+  typedef SensorStream<ScalarSensorStream<T, Config>, ScalarReportPolicy<T>, Config> Base;
+  friend Base;
+
+ public:
+  ScalarSensorStream() : value_(T{}) {}
+
+  ScalarSensorStream(const ConfigSchema &schema, const Config &defaults = Config())
+      : Base(schema, defaults), value_(T{}) {}
+
+  inline T value() { return value_; }
+
+  void setValue(T v) {
+    if (enabled_) {
+      value_ = v;
+      valid_ = true;
+      if (policy_.aggregate) {
+        accumulate(v);
+      }
+    }
+  }
+
+  // Applies the reporting policy. A true return is taken to mean that the
+  // report is sent, and becomes the reference for later changes.
+  bool shouldReport() {
+    if (!valid_ || (policy_.aggregate && count_ == 0)) return false;
+
+    uint32_t now = millis();
+    if (reported_) {
+      uint32_t silence = now - lastReportAt_;
+      if (silence < policy_.minInterval) return false;
+      if (policy_.onChange && !changed() &&
+          (policy_.maxSilence == 0 || silence < policy_.maxSilence)) {
+        return false;
+      }
+      if (value_ != lastReported_) {
+        direction_ = value_ > lastReported_ ? 1 : -1;
+      }
+    } else {
+      direction_ = 0;
+    }
+
+    reported_ = true;
+    lastReported_ = value_;
+    lastReportAt_ = now;
+    threshold_ = policy_.deadband;
+    if (policy_.relDeadband > 0) {
+      float ref = (float)value_;
+      T rel = (T)((ref < 0 ? -ref : ref) * policy_.relDeadband / 100);
+      if (rel > threshold_) threshold_ = rel;
+    }
+    return true;
+  }
+
+  // Periodic reports carry the window summary when aggregating, after
+  // which a new window begins.
+  void writeReport() {
+    if (!policy_.aggregate) {
+      this->report();
+      return;
+    }
+    proto->writeKey(STR_COUNT);
+    proto->writeUInt(count_);
+    proto->writeSpace();
+    proto->writeKey(STR_MIN);
+    writeValue(min_);
+    proto->writeSpace();
+    proto->writeKey(STR_MAX);
+    writeValue(max_);
+    proto->writeSpace();
+    proto->writeKey(STR_MEAN);
+    proto->write((float)(policy_.variance ? mean_ : sum_ / count_));
+    if (policy_.variance) {
+      proto->writeSpace();
+      proto->writeKey(STR_VARIANCE);
+      proto->write((float)(count_ > 1 ? m2_ / (count_ - 1) : 0));
+    }
+    resetWindow();
+  }
+
+ protected:
+  using Base::enabled_;
+  using Base::valid_;
+  using Base::policy_;
+  using Base::proto;
+  using Base::writeValue;
+
+ private:
+  void writeValues() { writeValue(value_); }
+
+  void resetReporting() {
+    reported_ = false;
+    resetWindow();
+  }
+
+  static int setPolicy(ScalarReportPolicy<T> *policy, const Arg &arg) {
+    switch (arg.keyID) {
+      case STR_ON_CHANGE:
+        if (arg.type != TOK_BOOL) return -1;
+        policy->onChange = arg.B;
+        return 1;
+      case STR_DEADBAND:
+        return Base::toValue(arg, &policy->deadband) ? 1 : -1;
+      case STR_DEADBAND_REL:
+        return Base::toValue(arg, &policy->relDeadband) ? 1 : -1;
+      case STR_HYSTERESIS:
+        return Base::toValue(arg, &policy->hysteresis) ? 1 : -1;
+      case STR_MIN_INTERVAL:
+        return toInterval(arg, &policy->minInterval) ? 1 : -1;
+      case STR_MAX_SILENCE:
+        return toInterval(arg, &policy->maxSilence) ? 1 : -1;
+      case STR_AGGREGATE:
+        if (arg.type != TOK_BOOL) return -1;
+        policy->aggregate = arg.B;
+        return 1;
+      case STR_VARIANCE:
+        if (arg.type != TOK_BOOL) return -1;
+        policy->variance = arg.B;
+        return 1;
+      default:
+        return 0;
+    }
+  }
+
+  static bool toInterval(const Arg &arg, uint16_t *dst) {
+    if (arg.type != TOK_INT || arg.I < 0 || arg.I > 0xFFFF) return false;
+    *dst = arg.I;
+    return true;
+  }
+
+  void resetWindow() {
+    count_ = 0;
+    sum_ = 0;
+    mean_ = 0;
+    m2_ = 0;
+  }
+
+  void accumulate(T v) {
+    if (count_ == 0 || v < min_) min_ = v;
+    if (count_ == 0 || v > max_) max_ = v;
+    count_++;
+    sum_ += v;
+    if (policy_.variance) {
+      // Welford's update; stable where sum of squares would not be
+      double delta = v - mean_;
+      mean_ += delta / count_;
+      m2_ += delta * (v - mean_);
+    }
+  }
+
+  // Returns true if value_ has moved far enough from lastReported_
+  bool changed() {
+    bool up = value_ > lastReported_;
+    T delta = up ? value_ - lastReported_ : lastReported_ - value_;
+    T required = threshold_;
+    if (direction_ != 0 && up != (direction_ > 0)) {
+      required += policy_.hysteresis;
+    }
+    return delta > required;
+  }
+
   T value_;
+
+  // Reporting state
+  bool reported_ = false;     // lastReported_ and lastReportAt_ are valid
+  int8_t direction_ = 0;      // direction of the last change reported (+1/-1)
+  T lastReported_ = 0;        // value sent in the last report
+  T threshold_ = 0;           // deadband around lastReported_
+  uint32_t lastReportAt_ = 0;  // time of the last report (millis())
+
+  // Aggregation window
+  uint32_t count_ = 0;  // samples in the window
+  T min_ = 0;
+  T max_ = 0;
+  double sum_ = 0;
+  double mean_ = 0;  // running mean (Welford; variance only)
+  double m2_ = 0;    // sum of squared deviations from the mean (Welford)
+};
+
+template <typename T>
+struct VectorReportPolicy {
+  bool delta = false;
+  uint16_t keyframe = 10;
+  T deadband = 0;
+
+  bool operator==(const VectorReportPolicy &o) const {
+    return delta == o.delta && keyframe == o.keyframe && deadband == o.deadband;
+  }
+};
+
+// VectorSensorStream reports N values together, such as the axes of an IMU
+// or the channels of a multi-channel ADC:
+//
+//   3!report 120 -4 998 17
+//
+// With delta reports on, the stream remembers the values it last sent and
+// reports only those that have changed since, each prefixed with its index:
+//
+//   3!report~ 1:-3 3:16
+//
+// A delta with nothing in it is not sent. Every keyframe-th scheduled
+// report, and the first after the stream is enabled or its settings
+// change, is sent in full, so that a host that missed a report, or joined
+// late, is back in step within keyframe report intervals. The policy is
+// set with the "set" command:
+//
+//   delta:<bool>          send deltas between keyframes
+//   keyframe:<n>          send every nth report in full (default 10)
+//   deadband:<n>          a value has only changed once it moves more than
+//                         n from the value last sent
+//
+// "read" always replies with every value.
+template <typename T, uint8_t N, typename Config = NoConfig>
+class VectorSensorStream
+    : public SensorStream<VectorSensorStream<T, N, Config>, VectorReportPolicy<T>, Config> {
+  static_assert(N > 0, "a vector sensor needs at least one value");
+
+  typedef SensorStream<VectorSensorStream<T, N, Config>, VectorReportPolicy<T>, Config> Base;
+  friend Base;
+
+ public:
+  VectorSensorStream() { memset(values_, 0, sizeof(values_)); }
+
+  VectorSensorStream(const ConfigSchema &schema, const Config &defaults = Config())
+      : Base(schema, defaults) {
+    memset(values_, 0, sizeof(values_));
+  }
+
+  inline T value(uint8_t i) { return values_[i]; }
+
+  void setValue(uint8_t i, T v) {
+    if (enabled_) {
+      values_[i] = v;
+      valid_ = true;
+    }
+  }
+
+  void setValues(const T *v) {
+    if (enabled_) {
+      memcpy(values_, v, sizeof(values_));
+      valid_ = true;
+    }
+  }
+
+  // Decides between a keyframe and a delta. A true return is taken to mean
+  // that the report is sent, and the values in it become the reference for
+  // later deltas.
+  bool shouldReport() {
+    if (!valid_) return false;
+
+    delta_ = policy_.delta && synced_ && ++sinceKeyframe_ < policy_.keyframe;
+    if (!delta_) {
+      memcpy(lastSent_, values_, sizeof(lastSent_));
+      sinceKeyframe_ = 0;
+      synced_ = true;
+      return true;
+    }
+
+    changed_.clear();
+    for (uint8_t i = 0; i < N; i++) {
+      if (changed(i)) {
+        changed_.set(i);
+        lastSent_[i] = values_[i];
+      }
+    }
+    return changed_.any();
+  }
+
+  void writeReport() {
+    if (!delta_) {
+      this->report();
+      return;
+    }
+    bool first = true;
+    for (uint16_t i = changed_.next(0); i < N; i = changed_.next(i + 1)) {
+      if (!first) proto->writeSpace();
+      first = false;
+      proto->writeUInt(i);
+      proto->out()->write(':');
+      writeValue(values_[i]);
+    }
+  }
+
+  bool deltaReport() { return delta_; }
+
+ protected:
+  using Base::enabled_;
+  using Base::valid_;
+  using Base::policy_;
+  using Base::proto;
+  using Base::writeValue;
+
+ private:
+  // Writes every value, separated by spaces
+  void writeValues() {
+    for (uint8_t i = 0; i < N; i++) {
+      if (i > 0) proto->writeSpace();
+      writeValue(values_[i]);
+    }
+  }
+
+  void resetReporting() { synced_ = false; }
+
+  static int setPolicy(VectorReportPolicy<T> *policy, const Arg &arg) {
+    switch (arg.keyID) {
+      case STR_DELTA:
+        if (arg.type != TOK_BOOL) return -1;
+        policy->delta = arg.B;
+        return 1;
+      case STR_KEYFRAME:
+        if (arg.type != TOK_INT || arg.I < 1 || arg.I > 0xFFFF) return -1;
+        policy->keyframe = arg.I;
+        return 1;
+      case STR_DEADBAND:
+        return Base::toValue(arg, &policy->deadband) ? 1 : -1;
+      default:
+        return 0;
+    }
+  }
+
+  // Returns true if value i has moved more than the deadband from the
+  // value last sent
+  bool changed(uint8_t i) {
+    T v = values_[i];
+    T last = lastSent_[i];
+    return (v > last ? v - last : last - v) > policy_.deadband;
+  }
+
+  T values_[N];
+
+  // Reporting state
+  bool synced_ = false;         // lastSent_ holds the values of a keyframe and later deltas
+  bool delta_ = false;          // the report being sent is a delta
+  uint16_t sinceKeyframe_ = 0;  // reports scheduled since the last keyframe
+  T lastSent_[N];               // value of each field as the host last saw it
+  Bitset<N> changed_;           // fields in the delta being sent
 };
+
+// CaptureStream records a burst of samples at a fixed rate into a ring
+// buffer and then sends them as binary frames, for signals that are too
+// fast for one report per sample. Subclasses implement sample(); call
+// tick() from loop().
+//
+//   capture <count> [<rate>] [trigger:<level>] [pre:<n>]
+//   capture off
+//
+// rate is in Hz, from 1 to 65535; without it a sample is taken on every
+// tick(), and the header gives rate:0. With a trigger, sampling is armed
+// and the capture begins at the first sample to rise through level,
+// preceded by up to n earlier samples. Once count samples are held, the
+// stream sends a header notification
+//
+//   <id>!capture count:<n> rate:<hz> pre:<n> seq:<s> chunks:<k>
+//
+// followed by k binary notifications, one per tick(), each holding a 16-bit
+// little-endian sequence number and up to ChunkSamples samples in the
+// device's byte order. Sequence numbers run on from one capture to the
+// next, starting at s, so the host can reassemble the block and detect
+// lost chunks.
+template <typename T, uint16_t Capacity, uint8_t ChunkSamples = 16>
+class CaptureStream : public Stream {
+  static_assert(Capacity > 0 && ChunkSamples > 0, "capture buffers must not be empty");
+
+ public:
+  void describe() {
+    proto->writeRaw(F("class:capture capacity:"));
+    proto->writeUInt(Capacity);
+  }
+
+  // Read one sample
+  virtual T sample() = 0;
+
+  void tick() {
+    switch (state_) {
+      case CAP_ARMED:
+      case CAP_RUNNING:
+        if (sampleDue()) {
+          record(sample());
+        }
+        // The header is sent on the tick that completes the capture, if
+        // the port allows
+        if (state_ != CAP_COMPLETE) break;
+        // fall through
+      case CAP_COMPLETE:
+        // The header and chunks wait while the port is backed up (see
+        // canNotify())
+        if (proto->canNotify()) {
+          sendHeader();
+        }
+        break;
+      case CAP_SENDING:
+        if (proto->canNotify()) {
+          sendChunk();
+        }
+        break;
+    }
+  }
+
+  // Returns true while a capture is armed, running or being sent
+  bool busy() { return state_ != CAP_IDLE; }
+
+  int handleMessage(uint8_t frameType, char *data, int len) {
+    if (frameType != FRAME_TYPE_TEXT) {
+      return STR_ERR_INVALID_ARG;
+    }
+
+    ZAP_PARSE_ARGS(data, len);
+
+    if (!args.scanWord(&arg)) {
+      return STR_ERR_INVALID_ARG;
+    } else if (arg.id != STR_CAPTURE) {
+      return STR_ERR_UNKNOWN_COMMAND;
+    }
+
+    if (!args.next(&arg) || arg.named()) {
+      return STR_ERR_INVALID_ARG;
+    } else if (arg.type == TOK_BOOL && !arg.B) {
+      state_ = CAP_IDLE;
+      return 0;
+    } else if (arg.type != TOK_INT || arg.I < 1 || (uint16_t)arg.I > Capacity) {
+      return STR_ERR_INVALID_ARG;
+    }
+
+    uint16_t count = arg.I;
+    uint16_t rate = 0;
+    uint16_t pre = 0;
+    bool triggered = false;
+
+    while (!args.end()) {
+      if (!args.next(&arg)) {
+        return STR_ERR_INVALID_ARG;
+      } else if (arg.positional() && arg.type == TOK_INT && arg.I >= 1 && arg.I <= 0xFFFF) {
+        rate = arg.I;
+      } else if (arg.keyID == STR_TRIGGER && arg.type == TOK_INT) {
+        level_ = (T)arg.I;
+        triggered = true;
+      } else if (arg.keyID == STR_TRIGGER && arg.type == TOK_FLOAT) {
+        level_ = (T)arg.F;
+        triggered = true;
+      } else if (arg.keyID == STR_PRE && arg.type == TOK_INT && arg.I >= 0 &&
+                 arg.I < count) {
+        pre = arg.I;
+      } else {
+        return STR_ERR_INVALID_ARG;
+      }
+    }
+
+    count_ = count;
+    rate_ = rate;
+    pre_ = triggered ? pre : 0;
+    period_ = rate > 0 ? 1000000UL / rate : 0;
+    nextSampleAt_ = micros();
+    wp_ = 0;
+    start_ = 0;
+    held_ = 0;
+    remaining_ = count;
+    state_ = triggered ? CAP_ARMED : CAP_RUNNING;
+
+    return 0;
+  }
+
+ private:
+  enum {
+    CAP_IDLE,     // no capture in progress
+    CAP_ARMED,    // sampling, waiting for the trigger
+    CAP_RUNNING,   // sampling until count samples are held
+    CAP_COMPLETE,  // samples held, header not yet sent
+    CAP_SENDING    // sending chunks
+  };
+
+  bool sampleDue() {
+    if (period_ == 0) return true;
+    uint32_t now = micros();
+    if ((int32_t)(now - nextSampleAt_) < 0) return false;
+    nextSampleAt_ += period_;
+    return true;
+  }
+
+  void record(T v) {
+    uint16_t ix = wp_;
+    buffer_[ix] = v;
+    wp_ = ix + 1 == Capacity ? 0 : ix + 1;
+
+    if (state_ == CAP_ARMED) {
+      bool fired = held_ > 0 && last_ < level_ && v >= level_;
+      last_ = v;
+      if (!fired) {
+        if (held_ < Capacity) held_++;
+        return;
+      }
+      // Keep as much pre-trigger history as has been recorded
+      if (held_ < pre_) pre_ = held_;
+      start_ = (ix + Capacity - pre_) % Capacity;
+      remaining_ = count_ - pre_;
+      state_ = CAP_RUNNING;
+    }
+
+    if (--remaining_ == 0) {
+      state_ = CAP_COMPLETE;
+    }
+  }
+
+  void sendHeader() {
+    rp_ = start_;
+    unsent_ = count_;
+    state_ = CAP_SENDING;
+
+    proto->startNotification(streamID);
+    proto->writeRawSpace(STR_CAPTURE);
+    proto->writeKey(STR_COUNT);
+    proto->writeUInt(count_);
+    proto->writeSpace();
+    proto->writeKey(STR_RATE);
+    proto->writeUInt(rate_);
+    proto->writeSpace();
+    proto->writeKey(STR_PRE);
+    proto->writeUInt(pre_);
+    proto->writeSpace();
+    proto->writeKey(STR_SEQ);
+    proto->writeUInt(seq_);
+    proto->writeSpace();
+    proto->writeKey(STR_CHUNKS);
+    proto->writeUInt((uint16_t)((count_ + ChunkSamples - 1) / ChunkSamples));
+    proto->endFrame();
+  }
+
+  void sendChunk() {
+    uint8_t chunk[2 + ChunkSamples * sizeof(T)];
+    uint16_t n = unsent_ < ChunkSamples ? unsent_ : ChunkSamples;
+
+    chunk[0] = seq_ & 0xFF;
+    chunk[1] = seq_ >> 8;
+
+    // Copy out of the ring in at most two runs
+    uint16_t run = Capacity - rp_;
+    if (run > n) run = n;
+    memcpy(chunk + 2, &buffer_[rp_], run * sizeof(T));
+    memcpy(chunk + 2 + run * sizeof(T), &buffer_[0], (n - run) * sizeof(T));
+    rp_ = (rp_ + n) % Capacity;
+
+    proto->startNotification(streamID);
+    proto->writeBinaryBody((char *)chunk, 2 + n * sizeof(T));
+    proto->endFrame();
+
+    seq_++;
+    unsent_ -= n;
+    if (unsent_ == 0) {
+      state_ = CAP_IDLE;
+    }
+  }
+
+  T buffer_[Capacity];  // sample ring
+  uint8_t state_ = CAP_IDLE;
+
+  // Capture parameters
+  uint16_t count_ = 0;    // samples per capture
+  uint16_t rate_ = 0;     // sample rate (Hz); 0 samples every tick
+  uint16_t pre_ = 0;      // pre-trigger samples
+  uint32_t period_ = 0;   // sample period (us)
+  T level_ = 0;           // trigger level
+
+  // Sampling state
+  uint32_t nextSampleAt_ = 0;  // time of the next sample (micros())
+  uint16_t wp_ = 0;            // ring write position
+  uint16_t start_ = 0;         // ring position of the first captured sample
+  uint16_t held_ = 0;          // samples recorded while armed
+  uint16_t remaining_ = 0;     // samples still to take
+  T last_ = 0;                 // previous sample, for trigger detection
+
+  // Sending state
+  uint16_t rp_ = 0;      // ring read position
+  uint16_t unsent_ = 0;  // samples still to send
+  uint16_t seq_ = 0;     // sequence number of the next chunk
+};
+
 };  // namespace zap
@@ -2,6 +2,8 @@
 
 namespace zap {
 
+#if ZAP_FLASH_ACCESSORS
+
 #define ZAP_STRING(name, ident, str) const char str_contents_##name[] PROGMEM = str;
 #include "zap_string_table.x.hpp"
 #undef ZAP_STRING
@@ -12,4 +14,56 @@ const char *const string_table[] PROGMEM = {
 };
 #undef ZAP_STRING
 
+#else
+
+#define ZAP_STRING(name, ident, str) {str, sizeof(str) - 1},
+extern constexpr StringTableEntry string_table[] = {
+#include "zap_string_table.x.hpp"
+};
+#undef ZAP_STRING
+
+#endif
+
+namespace {
+
+// Compile-time copy of the table, used only to build the index below
+#define ZAP_STRING(name, ident, str) str,
+constexpr const char *strings[] = {
+#include "zap_string_table.x.hpp"
+};
+#undef ZAP_STRING
+
+constexpr int STRING_COUNT = sizeof(strings) / sizeof(strings[0]);
+static_assert(STRING_COUNT <= 256, "string ids must fit in a uint8_t");
+
+constexpr int length(const char *str) { return *str ? 1 + length(str + 1) : 0; }
+
+constexpr uint8_t bucketOf(int ix) { return stringHash(strings[ix], length(strings[ix])); }
+
+// First id >= ix in bucket, or STR_INVALID_STRING
+constexpr uint8_t firstInBucket(int bucket, int ix) {
+  return ix >= STRING_COUNT         ? STR_INVALID_STRING
+         : bucketOf(ix) == bucket ? ix
+                                    : firstInBucket(bucket, ix + 1);
+}
+
+};  // namespace
+
+// The null string is never looked up, so chains start at id 1
+#define ZAP_HEAD(b) firstInBucket(b, 1)
+#define ZAP_HEADS4(b) ZAP_HEAD(b), ZAP_HEAD(b + 1), ZAP_HEAD(b + 2), ZAP_HEAD(b + 3)
+#define ZAP_HEADS16(b) ZAP_HEADS4(b), ZAP_HEADS4(b + 4), ZAP_HEADS4(b + 8), ZAP_HEADS4(b + 12)
+static_assert(STRING_INDEX_BUCKETS == 64, "string_index_heads initialiser assumes 64 buckets");
+const uint8_t string_index_heads[STRING_INDEX_BUCKETS] PROGMEM = {
+    ZAP_HEADS16(0), ZAP_HEADS16(16), ZAP_HEADS16(32), ZAP_HEADS16(48)};
+#undef ZAP_HEADS16
+#undef ZAP_HEADS4
+#undef ZAP_HEAD
+
+#define ZAP_STRING(name, ident, str) firstInBucket(bucketOf(STR_##ident), STR_##ident + 1),
+const uint8_t string_index_next[] PROGMEM = {
+#include "zap_string_table.x.hpp"
+};
+#undef ZAP_STRING
+
 };  // namespace zap
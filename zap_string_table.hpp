@@ -1,6 +1,8 @@
 #pragma once
 
 #include <avr/pgmspace.h>
+#include <stdint.h>
+#include <string.h>
 
 namespace zap {
 
@@ -11,6 +13,48 @@ enum {
 };
 #undef ZAP_STRING
 
+#if ZAP_FLASH_ACCESSORS
+
 extern const char *const string_table[] PROGMEM;
 
+#else
+
+// Where flash is readable in place the table is plain constant data, and
+// each entry carries its length so that it can be written in one call.
+struct StringTableEntry {
+  const char *str;
+  uint8_t len;
+};
+
+extern const StringTableEntry string_table[];
+
+// Compares a string to an entry in the string table, returning
+// true if the two are equal.
+inline bool streq(int strTableIx, const char *str) {
+  return strcmp(str, string_table[strTableIx].str) == 0;
+}
+
+// Return a pointer to an item in the string table
+inline const char *strptr(int strTableIx) { return string_table[strTableIx].str; }
+
+// Return the length of an item in the string table
+inline int strlength(int strTableIx) { return string_table[strTableIx].len; }
+
+#endif
+
+// Words are resolved to STR_ ids through a chained hash index over the
+// string table, built at compile time from the same X-macro file. Each
+// bucket holds the first id with that hash and string_index_next links
+// ids that share a bucket; STR_INVALID_STRING (0) ends a chain.
+constexpr int STRING_INDEX_BUCKETS = 64;  // must be a power of two
+
+constexpr uint8_t stringHash(const char *str, int len) {
+  return len == 0 ? 0
+                  : (uint8_t)((len * 31 + (uint8_t)str[0] * 5 + (uint8_t)str[len - 1] * 3) &
+                              (STRING_INDEX_BUCKETS - 1));
+}
+
+extern const uint8_t string_index_heads[STRING_INDEX_BUCKETS] PROGMEM;
+extern const uint8_t string_index_next[] PROGMEM;
+
 };  // namespace zap
@@ -6,6 +6,11 @@ ZAP_STRING(message, MESSAGE, "message")
 ZAP_STRING(true, TRUE, "true")
 ZAP_STRING(false, FALSE, "false")
 ZAP_STRING(report, REPORT, "report")
+ZAP_STRING(reports, REPORTS, "reports")
+ZAP_STRING(coalesce, COALESCE, "coalesce")
+ZAP_STRING(overrun, OVERRUN, "overrun")
+ZAP_STRING(skip, SKIP, "skip")
+ZAP_STRING(catch_up, CATCH_UP, "catch-up")
 ZAP_STRING(streams, STREAMS, "streams")
 ZAP_STRING(hello, HELLO, "hello")
 ZAP_STRING(desc, DESC, "desc")
@@ -14,9 +19,60 @@ ZAP_STRING(enable, ENABLE, "enable")
 ZAP_STRING(set, SET, "set")
 ZAP_STRING(mode, MODE, "mode")
 ZAP_STRING(wait, WAIT, "wait")
+ZAP_STRING(transport, TRANSPORT, "transport")
+ZAP_STRING(text, TEXT, "text")
+ZAP_STRING(cobs, COBS, "cobs")
+ZAP_STRING(ids, IDS, "ids")
+ZAP_STRING(extended, EXTENDED, "extended")
+ZAP_STRING(on_change, ON_CHANGE, "on-change")
+ZAP_STRING(deadband, DEADBAND, "deadband")
+ZAP_STRING(deadband_rel, DEADBAND_REL, "deadband-rel")
+ZAP_STRING(hysteresis, HYSTERESIS, "hysteresis")
+ZAP_STRING(min_interval, MIN_INTERVAL, "min-interval")
+ZAP_STRING(max_silence, MAX_SILENCE, "max-silence")
+ZAP_STRING(aggregate, AGGREGATE, "aggregate")
+ZAP_STRING(variance, VARIANCE, "variance")
+ZAP_STRING(delta, DELTA, "delta")
+ZAP_STRING(keyframe, KEYFRAME, "keyframe")
+ZAP_STRING(count, COUNT, "count")
+ZAP_STRING(min, MIN, "min")
+ZAP_STRING(max, MAX, "max")
+ZAP_STRING(mean, MEAN, "mean")
+ZAP_STRING(capture, CAPTURE, "capture")
+ZAP_STRING(rate, RATE, "rate")
+ZAP_STRING(trigger, TRIGGER, "trigger")
+ZAP_STRING(pre, PRE, "pre")
+ZAP_STRING(seq, SEQ, "seq")
+ZAP_STRING(chunks, CHUNKS, "chunks")
+ZAP_STRING(config, CONFIG, "config")
+ZAP_STRING(int, INT, "int")
+ZAP_STRING(float, FLOAT, "float")
+ZAP_STRING(bool, BOOL, "bool")
+ZAP_STRING(stats, STATS, "stats")
+ZAP_STRING(reset, RESET, "reset")
+ZAP_STRING(rx, RX, "rx")
+ZAP_STRING(tx, TX, "tx")
+ZAP_STRING(frames, FRAMES, "frames")
+ZAP_STRING(dropped, DROPPED, "dropped")
+ZAP_STRING(short, SHORT, "short")
+ZAP_STRING(hexit, HEXIT, "hexit")
+ZAP_STRING(binary, BINARY, "binary")
+ZAP_STRING(overflow, OVERFLOW, "overflow")
+ZAP_STRING(crc, CRC, "crc")
+ZAP_STRING(errors, ERRORS, "errors")
+ZAP_STRING(suppressed, SUPPRESSED, "suppressed")
+ZAP_STRING(deferred, DEFERRED, "deferred")
+ZAP_STRING(tick_max, TICK_MAX, "tick-max")
+ZAP_STRING(late, LATE, "late")
+ZAP_STRING(skipped, SKIPPED, "skipped")
 
+// Error codes must stay contiguous, from invalid-stream to too-long;
+// see ERROR_STAT_COUNT
 ZAP_STRING(err_invalid_stream, ERR_INVALID_STREAM, "invalid-stream")
 ZAP_STRING(err_invalid_arg, ERR_INVALID_ARG, "invalid-arg")
 ZAP_STRING(err_unknown_command, ERR_UNKNOWN_COMMAND, "unknown-command")
 ZAP_STRING(err_unknown_entity, ERR_UNKNOWN_ENTITY, "unknown-entity")
-ZAP_STRING(err_no_value, ERR_NO_VALUE, "no-value")
\ No newline at end of file
+ZAP_STRING(err_no_value, ERR_NO_VALUE, "no-value")
+ZAP_STRING(err_not_implemented, ERR_NOT_IMPLEMENTED, "not-implemented")
+ZAP_STRING(err_busy, ERR_BUSY, "busy")
+ZAP_STRING(err_too_long, ERR_TOO_LONG, "too-long")
\ No newline at end of file